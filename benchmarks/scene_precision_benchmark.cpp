@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <elementary_visualizer/elementary_visualizer.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ev = elementary_visualizer;
+
+// Renders the same overlapping translucent circles with each render target
+// precision, and prints the milliseconds per frame for each.
+// Usage: scene_precision_benchmark [number_of_frames]
+int main(int argc, char **argv)
+{
+    const unsigned int number_of_frames =
+        argc > 1 ? std::stoul(argv[1]) : 100;
+
+    const glm::ivec2 scene_size(1920, 1080);
+    const unsigned int number_of_circles = 100;
+    const int depth_peeling_passes = 4;
+
+    const std::vector<std::pair<ev::RenderTargetPrecision, std::string>>
+        precisions = {
+            {ev::RenderTargetPrecision::rgba8, "rgba8"},
+            {ev::RenderTargetPrecision::rgba16f, "rgba16f"},
+            {ev::RenderTargetPrecision::rgba32f, "rgba32f"}
+        };
+    for (const auto &[precision, precision_name] : precisions)
+    {
+        ev::SceneOptions options;
+        options.precision = precision;
+        auto scene = ev::Scene::create(
+            scene_size,
+            glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
+            4,
+            depth_peeling_passes,
+            options
+        );
+        if (!scene)
+            return EXIT_FAILURE;
+
+        for (unsigned int i = 0; i != number_of_circles; ++i)
+        {
+            const float phi = 2.0f * std::numbers::pi *
+                              static_cast<float>(i) / number_of_circles;
+
+            auto circle = ev::CircleVisual::create(glm::vec4(
+                0.5f + 0.5f * sinf(phi), 0.5f * cosf(phi), 0.5f, 0.3f
+            ));
+            if (!circle)
+                return EXIT_FAILURE;
+            scene.value()->add_visual(circle.value());
+
+            const glm::vec3 position(
+                0.3f * cosf(phi), 0.3f * sinf(phi), -0.5f + phi / 10.0f
+            );
+            const glm::mat4 model_0 =
+                glm::translate(glm::mat4(1.0f), position);
+            const glm::mat4 model_1 = glm::scale(model_0, glm::vec3(0.5f));
+            circle.value()->set_model(model_1);
+            circle.value()->set_view(glm::mat4(1.0f));
+            circle.value()->set_projection(
+                glm::ortho(-1.0f, +1.0f, -1.0f, +1.0f)
+            );
+        }
+
+        // The first frame is left out, since it may include
+        // one-time costs of the driver.
+        if (!ev::wait_until_rendered(scene.value()->render()))
+            return EXIT_FAILURE;
+
+        // Rendering is only queued on the GPU, so the time is measured
+        // until the last frame has completed.
+        const auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<const ev::RenderedScene> rendered_scene;
+        for (unsigned int frame = 0; frame != number_of_frames; ++frame)
+            rendered_scene = scene.value()->render();
+        if (!ev::wait_until_rendered(rendered_scene))
+            return EXIT_FAILURE;
+        const std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        std::cout << precision_name << ", milliseconds per frame: "
+                  << elapsed.count() / number_of_frames << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
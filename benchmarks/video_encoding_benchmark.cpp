@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <elementary_visualizer/elementary_visualizer.hpp>
+#include <filesystem>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <numbers>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ev = elementary_visualizer;
+
+// Renders the same animation into a video with an increasing number
+// of codec threads, then with an increasing number of chunk threads,
+// then into a lossless capture with each lossless codec,
+// and prints the frames per second for each. The lossless captures are
+// written next to the file, with the extension replaced by ".mkv".
+// Usage: video_encoding_benchmark [number_of_frames] [file_name]
+int main(int argc, char **argv)
+{
+    const unsigned int number_of_frames =
+        argc > 1 ? std::stoul(argv[1]) : 300;
+    const std::string file_name =
+        argc > 2 ? argv[2] : "video_encoding_benchmark.mp4";
+    const std::string lossless_file_name =
+        std::filesystem::path(file_name).replace_extension(".mkv").string();
+
+    const glm::ivec2 scene_size(1920, 1080);
+    auto scene =
+        ev::Scene::create(scene_size, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), 4, 1);
+    if (!scene)
+        return EXIT_FAILURE;
+
+    const unsigned int number_of_circles = 100;
+
+    std::vector<std::shared_ptr<ev::CircleVisual>> circles;
+    for (unsigned int i = 0; i != number_of_circles; ++i)
+    {
+        const float phi = 2.0f * std::numbers::pi * static_cast<float>(i) /
+                          number_of_circles;
+
+        auto circle = ev::CircleVisual::create(
+            glm::vec4(0.5f + 0.5f * sinf(phi), 0.5f * cosf(phi), 0.5f, 1.0f)
+        );
+        if (!circle)
+            return EXIT_FAILURE;
+        scene.value()->add_visual(circle.value());
+
+        circle.value()->set_view(glm::mat4(1.0f));
+        glm::mat4 projection = glm::ortho(-1.0f, +1.0f, -1.0f, +1.0f);
+        circle.value()->set_projection(projection);
+
+        circles.push_back(circle.value());
+    }
+
+    // Returns the frames per second, or 0 if the video cannot be created.
+    auto render_video = [&](const ev::VideoOutput &output)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        {
+            auto video = ev::Video::create({output}, scene_size, 30);
+            if (!video)
+                return 0.0;
+
+            for (unsigned int frame = 0; frame != number_of_frames; ++frame)
+            {
+                const float t = 0.05f * frame;
+                for (unsigned int i = 0; i != circles.size(); ++i)
+                {
+                    const float phi = 2.0f * std::numbers::pi *
+                                      static_cast<float>(i) / circles.size();
+                    const float magnitude = 0.8f * cosf(3.0f * phi + t);
+                    const glm::vec3 direction(cosf(phi), sinf(phi), 0.0f);
+                    const glm::mat4 model_0 =
+                        glm::translate(glm::mat4(1.0f), magnitude * direction);
+                    const glm::mat4 model_1 =
+                        glm::scale(model_0, glm::vec3(0.05f));
+                    circles[i]->set_model(model_1);
+                }
+
+                auto rendered_scene = scene.value()->render();
+                video.value()->render(rendered_scene);
+            }
+
+            // The video is flushed and closed here.
+        }
+
+        const std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return number_of_frames / elapsed.count();
+    };
+
+    const unsigned int max_thread_count =
+        std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int thread_count = 1; thread_count <= max_thread_count;
+         thread_count *= 2)
+    {
+        ev::VideoOutput output;
+        output.file_name = file_name;
+        output.bit_rate = 20000000;
+        output.options.codec_thread_count = thread_count;
+        const double frames_per_second = render_video(output);
+        if (frames_per_second == 0.0)
+            return EXIT_FAILURE;
+        std::cout << "codec threads: " << thread_count
+                  << ", frames per second: " << frames_per_second << std::endl;
+    }
+
+    for (unsigned int thread_count = 1; thread_count <= max_thread_count;
+         thread_count *= 2)
+    {
+        ev::VideoOutput output;
+        output.file_name = file_name;
+        output.bit_rate = 20000000;
+        output.options.chunk_size = 60;
+        output.options.chunk_thread_count = thread_count;
+        const double frames_per_second = render_video(output);
+        if (frames_per_second == 0.0)
+            return EXIT_FAILURE;
+        std::cout << "chunk threads: " << thread_count
+                  << ", frames per second: " << frames_per_second << std::endl;
+    }
+
+    const std::vector<std::pair<ev::LosslessCodec, std::string>>
+        lossless_codecs = {
+            {ev::LosslessCodec::utvideo, "utvideo"},
+            {ev::LosslessCodec::ffv1, "ffv1"},
+            {ev::LosslessCodec::raw, "raw"}
+        };
+    for (const auto &[codec, codec_name] : lossless_codecs)
+    {
+        const double frames_per_second = render_video(
+            ev::VideoOutput::lossless(lossless_file_name, codec)
+        );
+        if (frames_per_second == 0.0)
+            return EXIT_FAILURE;
+        std::cout << "lossless " << codec_name
+                  << ", frames per second: " << frames_per_second << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -7,10 +7,14 @@
 extern "C" {
 #include <libavcodec/codec_id.h>
 }
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
 #include <optional>
 #include <string>
 #include <tl/expected.hpp>
+#include <vector>
 
 namespace elementary_visualizer
 {
@@ -36,6 +40,19 @@ public:
     virtual void render(
         const glm::uvec2 &scene_size, const DepthPeelingData &depth_peeling_data
     ) const = 0;
+
+    /**
+     * @brief Whether every fragment of the visual is fully opaque.
+     *
+     * A Scene renders the opaque visuals only once, and peels
+     * only the translucent ones in front of them.
+     * The visuals of this library find it out from the alpha
+     * of their colors, whenever their data is set.
+     */
+    virtual bool is_opaque() const
+    {
+        return false;
+    }
 };
 
 struct Vertex
@@ -94,6 +111,7 @@ public:
     void render(
         const glm::uvec2 &scene_size, const DepthPeelingData &depth_peeling_data
     ) const;
+    bool is_opaque() const;
 
     void set_model(const glm::mat4 &model);
     void set_view(const glm::mat4 &view);
@@ -135,6 +153,7 @@ public:
     void render(
         const glm::uvec2 &scene_size, const DepthPeelingData &depth_peeling_data
     ) const;
+    bool is_opaque() const;
 
     void set_model(const glm::mat4 &model);
     void set_view(const glm::mat4 &view);
@@ -211,6 +230,7 @@ public:
     const std::vector<float> &get_position_data() const;
     const std::vector<float> &get_color_normal_data() const;
     std::vector<GLuint> get_index_data() const;
+    bool is_opaque() const;
 
 private:
 
@@ -243,6 +263,7 @@ public:
     void render(
         const glm::uvec2 &scene_size, const DepthPeelingData &depth_peeling_data
     ) const;
+    bool is_opaque() const;
 
     void set_model(const glm::mat4 &model);
     void set_view(const glm::mat4 &view);
@@ -293,6 +314,7 @@ public:
     void render(
         const glm::uvec2 &scene_size, const DepthPeelingData &depth_peeling_data
     ) const;
+    bool is_opaque() const;
 
     void set_model(const glm::mat4 &model);
     void set_view(const glm::mat4 &view);
@@ -312,6 +334,113 @@ private:
     CircleVisual(std::unique_ptr<Impl> impl);
 };
 
+/**
+ * @brief How the translucent fragments of a Scene are blended.
+ */
+enum class TransparencyMode
+{
+    depth_peeling,      /**< Depth peeling.
+                         * The visuals are rendered once for each depth
+                         * peeling pass, each pass peeling the next layer
+                         * of fragments, and the layers are blended
+                         * back to front. It is exact up to the number
+                         * of passes, but each pass renders the whole scene
+                         * into its own texture. The GPU skips the passes
+                         * after one which has nothing left to peel,
+                         * without the CPU waiting for them, so the number
+                         * of passes is only a maximum.
+                         */
+    weighted_blended,   /**< Weighted blended order-independent transparency.
+                         * The opaque visuals are rendered first, then
+                         * the translucent ones once, in front of them:
+                         * their fragments are summed up weighted by their
+                         * depth and alpha, and the sum is blended over
+                         * the opaque visuals and the background.
+                         * It is approximate: the order of the translucent
+                         * fragments is only taken into account through
+                         * the weights.
+                         */
+    a_buffer,           /**< A-buffer.
+                         * The visuals are rendered once, every fragment
+                         * is stored in a linked list of its pixel,
+                         * and the lists are sorted and blended back
+                         * to front. It is exact up to 32 fragments
+                         * for each pixel (or sample), the furthest ones
+                         * are left out above that.
+                         */
+    dual_depth_peeling  /**< Dual depth peeling.
+                         * Like depth peeling, but each pass peels
+                         * the nearest and the furthest layer at once,
+                         * so the same number of layers needs about half
+                         * as many passes, and only a constant number
+                         * of textures. The opaque visuals are rendered
+                         * once before the passes, so they take up none
+                         * of the peeled layers. The fragments at the same
+                         * depth are not blended with each other.
+                         */
+};
+
+/**
+ * @brief Precision of the render targets of a Scene.
+ */
+enum class RenderTargetPrecision
+{
+    rgba8,   /**< 8 bit colors and 24 bit depth.
+              * A quarter of the memory and fill bandwidth of rgba32f,
+              * but each translucent layer is rounded to 1/255 when
+              * it is stored, so many layers, and gradients blended
+              * over each other, show banding. The weighted blended
+              * transparency keeps half floats for its sums.
+              */
+    rgba16f, /**< Half float colors and 24 bit depth.
+              * Half of the memory and fill bandwidth of rgba32f.
+              * The blending error is around 1e-3, which is mostly
+              * invisible in an 8 bit video or window.
+              */
+    rgba32f  /**< Float colors and float depth.
+              * The blended colors are as exact as they can be,
+              * which makes the rendered scenes reproducible
+              * to the last bit, at the highest cost.
+              */
+};
+
+/**
+ * @brief Additional options of a Scene.
+ */
+struct SceneOptions
+{
+    TransparencyMode transparency_mode = TransparencyMode::depth_peeling;
+
+    /**
+     * @brief Precision of the depth peeling layers, the rendered scene,
+     * and the depth textures. The depths of the dual depth peeling
+     * and of the A-buffer are always floats.
+     */
+    RenderTargetPrecision precision = RenderTargetPrecision::rgba32f;
+
+    /**
+     * @brief Number of fragments the A-buffer can hold
+     * for each pixel of the Scene on average, 32 bytes each.
+     * The number of fragments is read back without waiting
+     * for the frame, so a frame with more fragments loses the ones
+     * which do not fit, and the A-buffer is grown to fit them
+     * for the next frames. Independently of this, at most the 32 nearest
+     * fragments of each pixel (or sample) are blended.
+     * Only used by the A-buffer transparency.
+     */
+    float a_buffer_fragments_per_pixel = 4.0f;
+
+    /**
+     * @brief Whether each depth peeling layer is blended under the
+     * previous ones right after it is peeled, front to back.
+     * Then the layers need two textures whatever the number of passes is,
+     * instead of one texture for each pass, but the result can differ
+     * in the last bits from the back to front blending.
+     * Only used by the depth peeling transparency.
+     */
+    bool incremental_depth_peeling = false;
+};
+
 class GlTexture;
 using RenderedScene = GlTexture;
 
@@ -323,7 +452,8 @@ public:
         const glm::uvec2 &size,
         const glm::vec4 &background_color = glm::vec4(1.0f),
         std::optional<int> samples = 4,
-        int depth_peeling_passes = 3
+        int depth_peeling_passes = 3,
+        const SceneOptions &options = SceneOptions()
     );
 
     Scene(Scene &&other);
@@ -352,6 +482,17 @@ private:
     Scene(std::unique_ptr<Impl> &&impl);
 };
 
+/**
+ * @brief Blocks until the rendering of a scene has completed.
+ *
+ * Scene::render only queues the rendering on the GPU. Window and Video
+ * wait for it by themselves when they read the rendered scene, so this
+ * is only needed e.g. to measure the time of the rendering.
+ */
+Expected<void, Error> wait_until_rendered(
+    const std::shared_ptr<const RenderedScene> &rendered_scene
+);
+
 enum class RenderMode
 {
     fill,
@@ -414,6 +555,406 @@ private:
 
 void poll_window_events();
 
+/**
+ * @brief What happens when a frame is rendered into a Video,
+ * but every frame of its encoding queue is still waiting to be encoded.
+ */
+enum class EncodingQueuePolicy
+{
+    block, /**< Block policy.
+            * The rendering waits until a frame is encoded.
+            * No frames are lost.
+            */
+    drop   /**< Drop policy.
+            * The rendered frame is dropped, and the rendering continues.
+            * The video will be shorter by the dropped frames.
+            */
+};
+
+/**
+ * @brief How the encoding of a Video is split between threads.
+ */
+enum class CodecThreadType
+{
+    frame,         /**< Frame threading.
+                    * Multiple frames are encoded at once, which adds
+                    * one frame of latency for each thread.
+                    */
+    slice,         /**< Slice threading.
+                    * Each frame is split into slices, which are
+                    * encoded at once.
+                    */
+    frame_or_slice /**< Frame threading if the codec supports it,
+                    * slice threading otherwise.
+                    */
+};
+
+/**
+ * @brief How the size of the encoded Video is controlled.
+ */
+enum class RateControl
+{
+    bit_rate,        /**< Bit rate rate control.
+                      * The codec aims for the bit rate of the Video.
+                      */
+    constant_quality /**< Constant quality rate control.
+                      * The bit rate of the Video is ignored, and the codec
+                      * encodes every frame with the same quality.
+                      */
+};
+
+/**
+ * @brief How the frames of a Video are timed.
+ */
+enum class CaptureMode
+{
+    offline,  /**< Offline capture.
+               * Each rendered frame is the next frame of the Video,
+               * no matter how long it took to render it.
+               */
+    real_time /**< Real-time capture.
+               * Each rendered frame is timed by a monotonic clock,
+               * which starts at the first frame, so the Video plays
+               * at the speed it was rendered at.
+               */
+};
+
+/**
+ * @brief How the frames of a real-time capture are fitted
+ * to the frame rate of the Video.
+ */
+enum class FrameRatePolicy
+{
+    variable, /**< Variable frame rate.
+               * The frames keep the time they were rendered at,
+               * in the time base of the capture.
+               * Frames falling on the same time are dropped.
+               */
+    constant  /**< Constant frame rate.
+               * The frames are timed at the frame rate of the Video.
+               * Frames rendered faster than that are dropped,
+               * and the missed frames are filled by repeating
+               * the previous frame.
+               */
+};
+
+/**
+ * @brief Codec of a lossless Video, see `VideoOutput::lossless`.
+ */
+enum class LosslessCodec
+{
+    utvideo, /**< UT Video in planar RGB with left prediction.
+              * It is fast to encode and to decode, with moderate
+              * compression. The packed frames are split into
+              * the planes by swscale.
+              */
+    ffv1,    /**< FFV1 level 3 in BGR0 with Golomb-Rice coding.
+              * It compresses better, but it is slower than UT Video.
+              * The frames are reordered into BGR0 by swscale.
+              */
+    raw      /**< Raw RGB24 frames.
+              * Nothing is encoded, the frames are only repacked
+              * from RGBA by swscale and written,
+              * so the output is the largest.
+              */
+};
+
+/**
+ * @brief Additional options of a Video.
+ */
+struct VideoOptions
+{
+    /**
+     * @brief Number of frames the encoding lags behind the rendering.
+     * The rendered scene is copied asynchronously from the GPU,
+     * and it is only encoded this many frames later,
+     * so that the copy does not stall the rendering.
+     * With 0, each frame is waited for and encoded immediately.
+     * The frames still in flight are encoded when the Video is destroyed.
+     */
+    unsigned int readback_lag = 2;
+
+    /**
+     * @brief Number of frames which can wait for encoding.
+     * If it is 0, the frames are encoded on the rendering thread.
+     * Otherwise, the frames are encoded on a background thread,
+     * and the rendering only copies the frame into the queue.
+     */
+    unsigned int encoding_queue_size = 0;
+
+    /**
+     * @brief What happens when the encoding queue is full.
+     * Only used if encoding_queue_size is not 0.
+     */
+    EncodingQueuePolicy encoding_queue_policy = EncodingQueuePolicy::block;
+
+    /**
+     * @brief Number of frames in a chunk for the chunked encoding.
+     * If it is not 0, the frames are cut into chunks of this many frames,
+     * which are encoded in parallel by independent codecs on a thread pool,
+     * and written into the video in order. Each chunk starts with
+     * an intra frame, and B-frames are not used.
+     * This is meant for offline rendering, where the encoding speed
+     * matters more than the video size.
+     * The encoding queue and the codec threads are not used with it.
+     */
+    unsigned int chunk_size = 0;
+
+    /**
+     * @brief Number of threads of the chunked encoding.
+     * If it is 0, it is the number of cores.
+     */
+    unsigned int chunk_thread_count = 0;
+
+    /**
+     * @brief Number of threads used by the codec.
+     * If it is 0, it is chosen based on the number of cores.
+     * If it is 1, the codec runs on the calling (or encoder) thread.
+     */
+    unsigned int codec_thread_count = 1;
+
+    /**
+     * @brief How the encoding is split between the codec threads.
+     * If the codec supports none of the requested types,
+     * it runs in a single thread.
+     */
+    CodecThreadType codec_thread_type = CodecThreadType::frame_or_slice;
+
+    /**
+     * @brief Maximum number of frames between two intra frames.
+     * Longer groups of pictures give smaller files,
+     * but seeking is slower.
+     */
+    unsigned int gop_size = 12;
+
+    /**
+     * @brief Maximum number of consecutive B-frames.
+     * If it is not set, the default of the codec is used.
+     */
+    std::optional<unsigned int> max_b_frames = std::nullopt;
+
+    /**
+     * @brief How the size of the encoded Video is controlled.
+     */
+    RateControl rate_control = RateControl::bit_rate;
+
+    /**
+     * @brief Quality for the constant quality rate control;
+     * lower is better. It is the CRF for codecs which support it
+     * (e.g. libx264, where 23 is the default),
+     * and the quantizer scale for the others.
+     */
+    float quality = 23.0f;
+
+    /**
+     * @brief Preset of the codec, for example "ultrafast" for libx264.
+     * If it is not set, the default preset of the codec is used.
+     */
+    std::optional<std::string> preset = std::nullopt;
+
+    /**
+     * @brief Name of the output format (the muxer), for example
+     * "yuv4mpegpipe" for raw Y4M, "rawvideo" for raw frames
+     * or "image2" for a numbered image sequence.
+     * If it is not set, it is figured out from the file name.
+     * The raw formats (rawvideo and yuv4mpegpipe) write the frames
+     * without encoding them. Image sequences are written with the codec
+     * of the image format, e.g. "frame_%05d.ppm" only copies the pixels.
+     */
+    std::optional<std::string> format_name = std::nullopt;
+
+    /**
+     * @brief Name of the pixel format of the encoded frames,
+     * for example "yuv420p" or "rgb24".
+     * If it is not set, it is the best match for RGB24 which is
+     * supported by the codec. For raw frames it is RGB24,
+     * except for Y4M (set by the format name, or by a ".y4m" file name),
+     * where it is YUV420P.
+     */
+    std::optional<std::string> pixel_format = std::nullopt;
+
+    /**
+     * @brief Additional private options of the codec and the muxer,
+     * for example `{{"tune", "zerolatency"}}` for libx264.
+     * Unknown options are ignored.
+     */
+    std::map<std::string, std::string> parameters = {};
+
+    /**
+     * @brief If set, the output is passed to this callback
+     * instead of being written into the file; the file name is then
+     * only used to figure out the format. If the callback returns false,
+     * the writing fails. The output cannot be seeked, so formats
+     * which seek back (like mp4) need to be configured not to,
+     * e.g. with the `{"movflags", "frag_keyframe+empty_moov"}` parameter.
+     * Formats which write their own files, like image sequences,
+     * cannot be written into it, and the creation fails.
+     */
+    std::function<bool(const uint8_t *data, size_t size)> output_callback =
+        nullptr;
+
+    /**
+     * @brief If set (and there is no output callback), the output is
+     * written into this memory instead of the file; the file name is then
+     * only used to figure out the format. The memory is cleared
+     * when the Video is created, then grown as needed,
+     * and it contains the whole video after the Video is destroyed.
+     * Like the callback, it cannot take image sequences.
+     */
+    std::shared_ptr<std::vector<uint8_t>> output_memory = nullptr;
+
+    /**
+     * @brief Size of the buffer in bytes in front of the output callback
+     * or the output memory. The output is passed on in chunks of this size.
+     */
+    size_t output_buffer_size = 65536;
+
+    /**
+     * @brief If it is not 0, a file output is written through a buffer
+     * of this size in bytes instead of the small default buffer,
+     * so that it is written in large blocks. It is not used
+     * with the output callback or memory, or with image sequences.
+     */
+    size_t output_file_buffer_size = 0;
+
+    /**
+     * @brief How the frames are timed. A real-time capture never waits
+     * for the encoding: the frames are always encoded on a background
+     * thread with the drop policy, with an encoding queue of
+     * 8 frames if encoding_queue_size is 0.
+     * The chunked encoding cannot be used with it.
+     */
+    CaptureMode capture_mode = CaptureMode::offline;
+
+    /**
+     * @brief How the frames of a real-time capture are fitted
+     * to the frame rate. Only used in real-time capture.
+     */
+    FrameRatePolicy frame_rate_policy = FrameRatePolicy::variable;
+
+    /**
+     * @brief Number of time units in a second for the variable frame rate
+     * of a real-time capture. Some codecs limit it, e.g. MPEG-4 Part 2
+     * takes at most 65535.
+     */
+    unsigned int capture_time_base = 1000;
+
+    /**
+     * @brief Whether GIF frames are quantized directly from RGB
+     * with a palette generated from the frames themselves,
+     * instead of being converted by swscale (through YUV420P
+     * if there is an intermediate YUV420P conversion). The frames are
+     * not converted to YUV420P then, whatever the intermediate
+     * YUV420P conversion is. Not used with the chunked encoding,
+     * or if a pixel format other than "pal8" is set.
+     */
+    bool palette_quantization = true;
+
+    /**
+     * @brief Number of frames which share a palette when the frames
+     * are quantized. With 0, the whole Video shares one palette.
+     */
+    unsigned int palette_segment_size = 256;
+
+    /**
+     * @brief Number of frames at the start of each palette segment,
+     * which the palette of the segment is generated from. These are
+     * buffered until the palette is generated, taking 2 bytes for each
+     * pixel, and the later frames of the segment are quantized
+     * with the cached palette as they arrive. If it is 0, it counts
+     * as 1.
+     */
+    unsigned int palette_sample_size = 4;
+};
+
+/**
+ * @brief One output of a Video with multiple outputs.
+ * The parameters are the same as the ones of `Video::create`.
+ */
+struct VideoOutput
+{
+    std::string file_name;
+    int64_t bit_rate = 5000000;
+    std::optional<enum AVCodecID> codec_id = std::nullopt;
+    bool intermediate_yuv420p_conversion = true;
+    VideoOptions options = VideoOptions();
+
+    /**
+     * @brief If set, the frames are not encoded, but published into
+     * the POSIX shared memory of this name, e.g. "/frames", for an other
+     * process on the same host. The layout of the shared memory is
+     * in shared_frame_ring.hpp. The file name, the bit rate, the codec
+     * and the options (except the readback lag) are not used.
+     */
+    std::optional<std::string> shared_memory_name = std::nullopt;
+
+    /**
+     * @brief Number of frames in the shared memory.
+     */
+    unsigned int shared_memory_slot_count = 4;
+
+    /**
+     * @brief What happens when every frame of the shared memory
+     * is still held by the consumer. The block policy waits
+     * for the consumer.
+     */
+    EncodingQueuePolicy shared_memory_policy = EncodingQueuePolicy::drop;
+
+    /**
+     * @brief With the block policy, the longest time in milliseconds
+     * a frame waits for the consumer, after which the rendering fails.
+     * It also fails as soon as the attached consumer process is gone.
+     * If it is 0, the frames wait as long as the consumer is alive,
+     * or forever if no consumer has attached.
+     */
+    unsigned int shared_memory_timeout = 5000;
+
+    /**
+     * @brief Output of a lossless capture, which is meant to be
+     * transcoded later. It uses a cheap lossless codec in an RGB pixel
+     * format, so the frames skip the YUV420P conversion, and it is
+     * written through a large buffer. None of the codecs takes
+     * the RGBA readback as it is, so the frames still go through
+     * swscale, but only to repack the same RGB values.
+     * Every frame is an intra frame. The format is Matroska,
+     * the pixel format and the codec parameters are those of
+     * the codec, unless they are set in the options.
+     *
+     * @param file_name Output filename, e.g. "capture.mkv".
+     *
+     * @param codec Lossless codec.
+     *
+     * @param options Additional options, where a 0 output file buffer
+     * size means 8 MiB.
+     *
+     * @return The output, which can be passed to `Video::create`.
+     */
+    static VideoOutput lossless(
+        const std::string &file_name,
+        const LosslessCodec codec = LosslessCodec::utvideo,
+        const VideoOptions &options = VideoOptions()
+    );
+
+    /**
+     * @brief Output which publishes the frames into shared memory,
+     * see shared_memory_name.
+     *
+     * @param name Name of the shared memory, which must not exist yet.
+     * It is unlinked when the Video is destroyed.
+     *
+     * @param slot_count Number of frames in the shared memory.
+     *
+     * @param policy What happens when the shared memory is full.
+     *
+     * @return The output, which can be passed to `Video::create`.
+     */
+    static VideoOutput shared_memory(
+        const std::string &name,
+        const unsigned int slot_count = 4,
+        const EncodingQueuePolicy policy = EncodingQueuePolicy::drop
+    );
+};
+
 class Video
 {
 public:
@@ -422,7 +963,10 @@ public:
      * @brief Creates a Video.
      *
      * @param file_name Output filename.
-     * The file format will be figured out from the extension.
+     * The file format will be figured out from the extension,
+     * unless it is set in the options.
+     * It can also be "pipe:N" to write into the file descriptor N,
+     * for example "pipe:1" for the standard output.
      *
      * @param size Width and height in pixels.
      *
@@ -433,7 +977,9 @@ public:
      * @param intermediate_yuv420p_conversion
      * Whether to insert an additional conversion step for each frame creation.
      * Intermediate YUV420P conversion is necessary for
-     * correct gif creation. Without it, gifs have strange colors.
+     * correct gif creation through swscale. Without it, gifs have
+     * strange colors. It has no effect on gifs whose frames are
+     * quantized by their palette, see VideoOptions::palette_quantization.
      * The rendered texture is always converted to a pixel format
      * which is the best (and supported) for the current video format.
      * This option introduces an intermedia conversion between
@@ -443,6 +989,8 @@ public:
      * In these cases, this argument has no effect.
      * This can be turned off for more performant video creation.
      *
+     * @param options Additional options for the readback and encoding.
+     *
      * @return A Video object if it is successful, an Error otherwise.
      */
     static Expected<std::shared_ptr<Video>, Error> create(
@@ -451,17 +999,59 @@ public:
         const unsigned int frame_rate = 30,
         const int64_t bit_rate = 5000000,
         const std::optional<enum AVCodecID> codec_id = std::nullopt,
-        const bool intermediate_yuv420p_conversion = true
+        const bool intermediate_yuv420p_conversion = true,
+        const VideoOptions &options = VideoOptions()
+    );
+
+    /**
+     * @brief Creates a Video, which writes the same frames
+     * into multiple outputs, e.g. both an mp4 and a gif.
+     * Each frame is read back and converted once, and then it is encoded
+     * by each output on its own. The encoding lags behind
+     * by the longest readback lag of the outputs.
+     *
+     * @param outputs Outputs of the Video, at least one.
+     *
+     * @param size Width and height in pixels.
+     *
+     * @param frame_rate Frame rate of every output.
+     *
+     * @return A Video object if it is successful, an Error otherwise.
+     */
+    static Expected<std::shared_ptr<Video>, Error> create(
+        const std::vector<VideoOutput> &outputs,
+        const glm::uvec2 &size,
+        const unsigned int frame_rate = 30
     );
 
     Video(Video &&other);
     Video &operator=(Video &&other);
 
-    void render(
+    /**
+     * @brief Writes the rendered scene as the next frame of every output.
+     *
+     * The frames are read back and encoded with a lag, possibly
+     * on background threads, so a failure is reported by a later call.
+     *
+     * @return An Error if writing this or any earlier frame has failed,
+     * or the Video is already finished.
+     */
+    Expected<void, Error> render(
         std::shared_ptr<const RenderedScene> rendered_scene,
         const RenderMode = RenderMode::fill
     );
 
+    /**
+     * @brief Writes every frame which is still in flight,
+     * and closes the outputs. Later frames are not written.
+     *
+     * The destructor does the same, but it cannot report
+     * the failures, so this should be called to find them out.
+     *
+     * @return An Error if writing any frame has failed.
+     */
+    Expected<void, Error> finish();
+
     ~Video();
 
     Video(const Video &other) = delete;
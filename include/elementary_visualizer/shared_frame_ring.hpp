@@ -0,0 +1,98 @@
+#ifndef ELEMENTARY_VISUALIZER_SHARED_FRAME_RING_HPP
+#define ELEMENTARY_VISUALIZER_SHARED_FRAME_RING_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @file
+ * Layout of the POSIX shared memory, into which a Video publishes
+ * its frames (see `VideoOutput::shared_memory`). It only depends on
+ * the standard library, so consumers can include it on its own.
+ *
+ * The shared memory starts with a SharedFrameRingHeader, which is followed
+ * at `slots_offset` bytes by `slot_count` slots, each `slot_size` bytes
+ * long. Each slot starts with a SharedFrameSlotHeader, which is followed
+ * by the frame at `frame_offset` bytes from the start of the slot.
+ *
+ * There is a single producer and a single consumer. The producer writes
+ * the slot `write_index % slot_count`, and then increments the write index.
+ * The consumer reads the slot `read_index % slot_count` in place
+ * while the read index is below the write index, and then increments
+ * the read index, which hands the slot back to the producer.
+ *
+ * The consumer waits for the magic before reading the rest of the header,
+ * and it stores its process id once it is attached. A producer which
+ * waits for a slot gives up if that process is gone.
+ */
+
+namespace elementary_visualizer
+{
+/**
+ * @brief Value of `SharedFrameRingHeader::magic`, "EVFR".
+ */
+inline constexpr uint32_t shared_frame_ring_magic = 0x52465645;
+
+/**
+ * @brief Value of `SharedFrameRingHeader::version`.
+ */
+inline constexpr uint32_t shared_frame_ring_version = 1;
+
+/**
+ * @brief Pixel format of the frames in the shared memory.
+ */
+enum class SharedFrameFormat : uint32_t
+{
+    rgba8 = 0 /**< RGBA8 format.
+               * 4 bytes per pixel, the rows start with the top row,
+               * and they are `4 * width` bytes long without padding.
+               */
+};
+
+/**
+ * @brief Header at the start of the shared memory.
+ */
+struct SharedFrameRingHeader
+{
+    // Stored last by the producer, once the rest of the header is set.
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    SharedFrameFormat format;
+    uint32_t slot_count;
+    // Offset of the first slot from the start of the shared memory,
+    // in bytes.
+    uint64_t slots_offset;
+    // Size of a slot including its header, in bytes.
+    uint64_t slot_size;
+    // Offset of the frame from the start of its slot, in bytes.
+    uint64_t frame_offset;
+    // Size of a frame, in bytes.
+    uint64_t frame_size;
+    // Number of frames published by the producer.
+    std::atomic<uint64_t> write_index;
+    // Number of frames released by the consumer.
+    std::atomic<uint64_t> read_index;
+    // Set when the producer will not publish any more frames.
+    std::atomic<uint32_t> closed;
+    // Process id of the consumer, 0 until a consumer is attached.
+    std::atomic<int32_t> consumer_pid;
+};
+
+/**
+ * @brief Header at the start of each slot.
+ */
+struct SharedFrameSlotHeader
+{
+    // Number of the frame among every rendered frame, so frames dropped
+    // because of a full ring show up as gaps.
+    uint64_t sequence;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+static_assert(std::atomic<int32_t>::is_always_lock_free);
+}
+
+#endif
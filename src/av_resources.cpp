@@ -1,4 +1,8 @@
+#include <algorithm>
 #include <av_resources.hpp>
+#include <limits>
+#include <palette_quantizer.hpp>
+#include <thread>
 
 namespace elementary_visualizer
 {
@@ -52,6 +56,54 @@ WrappedAvPacket::~WrappedAvPacket()
 
 WrappedAvPacket::WrappedAvPacket(AVPacket *packet) : packet(packet) {}
 
+Expected<std::shared_ptr<WrappedSwsContext>, Error> WrappedSwsContext::create()
+{
+    return std::shared_ptr<WrappedSwsContext>(new WrappedSwsContext());
+}
+
+Expected<void, Error>
+    WrappedSwsContext::scale(const AVFrame *source, AVFrame *destination)
+{
+    // Returns the current context if the parameters did not change,
+    // otherwise frees it and creates a new one.
+    this->sws_context = sws_getCachedContext(
+        this->sws_context,
+        source->width,
+        source->height,
+        static_cast<enum AVPixelFormat>(source->format),
+        destination->width,
+        destination->height,
+        static_cast<enum AVPixelFormat>(destination->format),
+        SWS_BICUBIC,
+        nullptr,
+        nullptr,
+        nullptr
+    );
+    if (!this->sws_context)
+        return Unexpected<Error>(Error());
+
+    int result = sws_scale(
+        this->sws_context,
+        (const uint8_t *const *)source->data,
+        source->linesize,
+        0,
+        source->height,
+        destination->data,
+        destination->linesize
+    );
+    if (result < 0)
+        return Unexpected<Error>(Error());
+
+    return Expected<void, Error>();
+}
+
+WrappedSwsContext::~WrappedSwsContext()
+{
+    sws_freeContext(this->sws_context);
+}
+
+WrappedSwsContext::WrappedSwsContext() : sws_context(nullptr) {}
+
 Expected<std::shared_ptr<WrappedAvFrame>, Error> WrappedAvFrame::create(
     const enum AVPixelFormat pixel_format,
     const unsigned int width,
@@ -88,8 +140,9 @@ const AVFrame *WrappedAvFrame::operator*() const
     return this->frame;
 }
 
-Expected<void, Error>
-    WrappedAvFrame::convert_and_copy(const WrappedAvFrame &source)
+Expected<void, Error> WrappedAvFrame::convert_and_copy(
+    const WrappedAvFrame &source, WrappedSwsContext &sws_context
+)
 {
     int result;
 
@@ -107,34 +160,10 @@ Expected<void, Error>
     }
     else
     {
-        struct SwsContext *sws_context = sws_getContext(
-            source.frame->width,
-            source.frame->height,
-            static_cast<enum AVPixelFormat>(source.frame->format),
-            this->frame->width,
-            this->frame->height,
-            static_cast<enum AVPixelFormat>(this->frame->format),
-            SWS_BICUBIC,
-            nullptr,
-            nullptr,
-            nullptr
-        );
-        if (!sws_context)
-            return Unexpected<Error>(Error());
-
-        result = sws_scale(
-            sws_context,
-            (const uint8_t *const *)source.frame->data,
-            source.frame->linesize,
-            0,
-            source.frame->height,
-            this->frame->data,
-            this->frame->linesize
-        );
-        if (result < 0)
+        Expected<void, Error> scale_result =
+            sws_context.scale(source.frame, this->frame);
+        if (!scale_result)
             return Unexpected<Error>(Error());
-
-        sws_freeContext(sws_context);
     }
 
     return Expected<void, Error>();
@@ -156,7 +185,8 @@ Expected<std::shared_ptr<WrappedAvCodecContext>, Error>
         const unsigned int frame_rate,
         const enum AVPixelFormat source_pixel_format,
         const int additional_flags,
-        const WrappedAvDictionary &parameters
+        const WrappedAvDictionary &parameters,
+        const CodecSettings &settings
     )
 {
     const AVCodec *codec;
@@ -167,9 +197,13 @@ Expected<std::shared_ptr<WrappedAvCodecContext>, Error>
     if (codec->type != AVMEDIA_TYPE_VIDEO)
         return Unexpected<Error>(Error());
 
-    const enum AVPixelFormat pixel_format = avcodec_find_best_pix_fmt_of_list(
-        codec->pix_fmts, source_pixel_format, 0, nullptr
-    );
+    enum AVPixelFormat pixel_format = source_pixel_format;
+    if (settings.pixel_format)
+        pixel_format = settings.pixel_format.value();
+    else if (codec->pix_fmts)
+        pixel_format = avcodec_find_best_pix_fmt_of_list(
+            codec->pix_fmts, source_pixel_format, 0, nullptr
+        );
     if (pixel_format == AV_PIX_FMT_NONE)
         return Unexpected<Error>(Error());
 
@@ -191,12 +225,24 @@ Expected<std::shared_ptr<WrappedAvCodecContext>, Error>
     // timebase should be 1/framerate and timestamp increments should be
     // identical to 1.
     codec_context->time_base = (AVRational){1, static_cast<int>(frame_rate)};
+    if (settings.time_base)
+    {
+        // Variable frame rate: the frame rate is only a hint,
+        // and the timestamps are in the finer time base.
+        codec_context->time_base = settings.time_base.value();
+        codec_context->framerate =
+            (AVRational){static_cast<int>(frame_rate), 1};
+    }
 
-    // Emit one intra frame every twelve frames at most.
-    codec_context->gop_size = 12;
+    // Emit one intra frame every `gop_size` frames at most.
+    codec_context->gop_size = settings.gop_size;
     codec_context->pix_fmt = pixel_format;
 
-    if (codec_context->codec_id == AV_CODEC_ID_MPEG2VIDEO)
+    if (settings.max_b_frames)
+    {
+        codec_context->max_b_frames = settings.max_b_frames.value();
+    }
+    else if (codec_context->codec_id == AV_CODEC_ID_MPEG2VIDEO)
     {
         // Just for testing, we also add B-frames.
         codec_context->max_b_frames = 2;
@@ -211,6 +257,31 @@ Expected<std::shared_ptr<WrappedAvCodecContext>, Error>
 
     codec_context->flags |= additional_flags;
 
+    if (settings.constant_quality)
+    {
+        const float quality = settings.constant_quality.value();
+        codec_context->bit_rate = 0;
+        // Codecs with a CRF option (e.g. libx264, libx265, libvpx) use it,
+        // the others use a fixed quantizer scale.
+        if (codec_context->priv_data &&
+            av_opt_find(codec_context->priv_data, "crf", nullptr, 0, 0))
+        {
+            av_opt_set_double(codec_context->priv_data, "crf", quality, 0);
+        }
+        else
+        {
+            codec_context->flags |= AV_CODEC_FLAG_QSCALE;
+            codec_context->global_quality =
+                static_cast<int>(FF_QP2LAMBDA * quality);
+        }
+    }
+
+    // With both thread types, frame threading is preferred.
+    // If the codec supports none of the thread types,
+    // it runs in a single thread (unless it has its own threading).
+    codec_context->thread_count = settings.thread_count;
+    codec_context->thread_type = settings.thread_type;
+
     WrappedAvDictionary copied_parameters(parameters);
     AVDictionary *p_copied_parameters = copied_parameters.dictionary;
     // Open the codec.
@@ -258,6 +329,12 @@ const AVStream *WrappedVideoAvStream::operator*() const
 
 WrappedVideoAvStream::~WrappedVideoAvStream()
 {
+    // A segment which ends before its sample is complete gets
+    // the palette of the frames it has.
+    if (this->palette_quantizer &&
+        this->palette_quantizer->get_frame_count() > 0)
+        this->write_palette_frames();
+
     if (!this->is_state_eof)
     {
         this->enter_codec_flush_mode();
@@ -270,16 +347,230 @@ WrappedVideoAvStream::WrappedVideoAvStream(
     std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context,
     AVStream *stream,
     std::shared_ptr<WrappedAvFrame> frame,
-    std::shared_ptr<WrappedAvPacket> packet
+    std::shared_ptr<WrappedAvFrame> frame_yuv420p,
+    std::shared_ptr<WrappedSwsContext> sws_context,
+    std::shared_ptr<WrappedSwsContext> sws_context_yuv420p,
+    std::shared_ptr<WrappedAvPacket> packet,
+    std::shared_ptr<PaletteQuantizer> palette_quantizer,
+    const bool repeat_frames_into_gaps
 )
     : format_context(format_context),
       stream(stream),
       frame(frame),
+      frame_yuv420p(frame_yuv420p),
+      sws_context(sws_context),
+      sws_context_yuv420p(sws_context_yuv420p),
       packet(packet),
+      palette_quantizer(palette_quantizer),
       is_state_eof(true),
+      repeat_frames_into_gaps(repeat_frames_into_gaps),
       timestamp(0)
 {}
 
+Expected<std::shared_ptr<WrappedAvIoContext>, Error> WrappedAvIoContext::create(
+    WriteCallback write_callback, const size_t buffer_size
+)
+{
+    if (!write_callback)
+        return Unexpected<Error>(Error());
+
+    return WrappedAvIoContext::allocate_io_context(
+        std::shared_ptr<WrappedAvIoContext>(
+            new WrappedAvIoContext(write_callback, nullptr, nullptr)
+        ),
+        buffer_size
+    );
+}
+
+Expected<std::shared_ptr<WrappedAvIoContext>, Error> WrappedAvIoContext::create(
+    std::shared_ptr<std::vector<uint8_t>> memory, const size_t buffer_size
+)
+{
+    if (!memory)
+        return Unexpected<Error>(Error());
+    // The writing starts at the beginning, so anything left in the memory
+    // would remain after the end of the output.
+    memory->clear();
+
+    return WrappedAvIoContext::allocate_io_context(
+        std::shared_ptr<WrappedAvIoContext>(
+            new WrappedAvIoContext(nullptr, memory, nullptr)
+        ),
+        buffer_size
+    );
+}
+
+Expected<std::shared_ptr<WrappedAvIoContext>, Error>
+    WrappedAvIoContext::create(const std::string &url, const size_t buffer_size)
+{
+    // The direct flag bypasses the small buffer of FFmpeg,
+    // so each full buffer is written at once.
+    AVIOContext *url_io_context = nullptr;
+    int result = avio_open(
+        &url_io_context, url.c_str(), AVIO_FLAG_WRITE | AVIO_FLAG_DIRECT
+    );
+    if (result < 0)
+        return Unexpected<Error>(Error());
+
+    return WrappedAvIoContext::allocate_io_context(
+        std::shared_ptr<WrappedAvIoContext>(
+            new WrappedAvIoContext(nullptr, nullptr, url_io_context)
+        ),
+        buffer_size
+    );
+}
+
+AVIOContext *WrappedAvIoContext::operator*()
+{
+    return this->io_context;
+}
+
+const AVIOContext *WrappedAvIoContext::operator*() const
+{
+    return this->io_context;
+}
+
+WrappedAvIoContext::~WrappedAvIoContext()
+{
+    if (this->io_context)
+    {
+        // The buffer might have been reallocated by FFmpeg,
+        // so it is freed through the context.
+        av_freep(&this->io_context->buffer);
+        avio_context_free(&this->io_context);
+    }
+    if (this->url_io_context)
+        avio_closep(&this->url_io_context);
+}
+
+WrappedAvIoContext::WrappedAvIoContext(
+    WriteCallback write_callback,
+    std::shared_ptr<std::vector<uint8_t>> memory,
+    AVIOContext *url_io_context
+)
+    : write_callback(write_callback),
+      memory(memory),
+      position(0),
+      url_io_context(url_io_context),
+      io_context(nullptr)
+{}
+
+Expected<std::shared_ptr<WrappedAvIoContext>, Error>
+    WrappedAvIoContext::allocate_io_context(
+        std::shared_ptr<WrappedAvIoContext> wrapped_io_context,
+        const size_t buffer_size
+    )
+{
+    // FFmpeg takes the size of the buffer as an int.
+    if (buffer_size == 0 ||
+        buffer_size > static_cast<size_t>(std::numeric_limits<int>::max()))
+        return Unexpected<Error>(Error());
+
+    unsigned char *buffer =
+        static_cast<unsigned char *>(av_malloc(buffer_size));
+    if (!buffer)
+        return Unexpected<Error>(Error());
+
+    // Only the memory and the seekable urls can be seeked.
+    const bool seekable =
+        wrapped_io_context->memory ||
+        (wrapped_io_context->url_io_context &&
+         (wrapped_io_context->url_io_context->seekable &
+          AVIO_SEEKABLE_NORMAL));
+    wrapped_io_context->io_context = avio_alloc_context(
+        buffer,
+        static_cast<int>(buffer_size),
+        1,
+        wrapped_io_context.get(),
+        nullptr,
+        WrappedAvIoContext::write_packet,
+        seekable ? WrappedAvIoContext::seek : nullptr
+    );
+    if (!wrapped_io_context->io_context)
+    {
+        av_free(buffer);
+        return Unexpected<Error>(Error());
+    }
+
+    return wrapped_io_context;
+}
+
+int WrappedAvIoContext::write_packet(
+    void *opaque, uint8_t *buffer, int buffer_size
+)
+{
+    WrappedAvIoContext *wrapped_io_context =
+        static_cast<WrappedAvIoContext *>(opaque);
+
+    if (wrapped_io_context->write_callback)
+    {
+        if (!wrapped_io_context->write_callback(buffer, buffer_size))
+            return AVERROR_EXTERNAL;
+        return buffer_size;
+    }
+
+    if (wrapped_io_context->url_io_context)
+    {
+        AVIOContext *url_io_context = wrapped_io_context->url_io_context;
+        avio_write(url_io_context, buffer, buffer_size);
+        if (url_io_context->error < 0)
+            return url_io_context->error;
+        return buffer_size;
+    }
+
+    std::vector<uint8_t> &memory = *wrapped_io_context->memory;
+    const size_t end = wrapped_io_context->position + buffer_size;
+    if (end > memory.size())
+        memory.resize(end);
+    std::copy_n(
+        buffer, buffer_size, memory.begin() + wrapped_io_context->position
+    );
+    wrapped_io_context->position = end;
+    return buffer_size;
+}
+
+int64_t WrappedAvIoContext::seek(void *opaque, int64_t offset, int whence)
+{
+    WrappedAvIoContext *wrapped_io_context =
+        static_cast<WrappedAvIoContext *>(opaque);
+
+    // The force flag may be combined with any of the others,
+    // and it makes no difference here.
+    whence &= ~AVSEEK_FORCE;
+
+    if (wrapped_io_context->url_io_context)
+    {
+        if (whence == AVSEEK_SIZE)
+            return avio_size(wrapped_io_context->url_io_context);
+        return avio_seek(wrapped_io_context->url_io_context, offset, whence);
+    }
+
+    const int64_t size =
+        static_cast<int64_t>(wrapped_io_context->memory->size());
+
+    if (whence == AVSEEK_SIZE)
+        return size;
+
+    int64_t position;
+    if (whence == SEEK_SET)
+        position = offset;
+    else if (whence == SEEK_CUR)
+        position =
+            static_cast<int64_t>(wrapped_io_context->position) + offset;
+    else if (whence == SEEK_END)
+        position = size + offset;
+    else
+        return AVERROR(EINVAL);
+
+    // Seeking past the end is allowed,
+    // the gap is filled with zeros by the next write.
+    if (position < 0)
+        return AVERROR(EINVAL);
+
+    wrapped_io_context->position = static_cast<size_t>(position);
+    return position;
+}
+
 Expected<std::shared_ptr<WrappedOutputVideoAvFormatContext>, Error>
     WrappedOutputVideoAvFormatContext::create(
         const std::string &filename,
@@ -291,7 +582,9 @@ Expected<std::shared_ptr<WrappedOutputVideoAvFormatContext>, Error>
         const enum AVPixelFormat source_pixel_format,
         const WrappedAvDictionary &parameters,
         const std::optional<enum AVCodecID> codec_id,
-        const bool intermediate_yuv420p_conversion
+        const bool intermediate_yuv420p_conversion,
+        const CodecSettings &codec_settings,
+        std::shared_ptr<WrappedAvIoContext> io_context
     )
 {
     AVFormatContext *format_context;
@@ -304,31 +597,73 @@ Expected<std::shared_ptr<WrappedOutputVideoAvFormatContext>, Error>
     if (!format_context || result < 0)
         return Unexpected<Error>(Error());
 
+    // Formats without a file (e.g. image sequences) open their outputs
+    // on their own, so they would never write into the custom output.
+    if (io_context && (format_context->oformat->flags & AVFMT_NOFILE))
+    {
+        avformat_free_context(format_context);
+        return Unexpected<Error>(Error());
+    }
+
+    // The custom output must not be closed by FFmpeg.
+    if (io_context)
+        format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+
     // Some formats want stream headers to be separate.
     int codec_additional_flags = 0;
     if (format_context->oformat->flags & AVFMT_GLOBALHEADER)
         codec_additional_flags = AV_CODEC_FLAG_GLOBAL_HEADER;
 
-    Expected<std::shared_ptr<WrappedAvCodecContext>, Error> codec_context =
-        WrappedAvCodecContext::create(
-            codec_id ? codec_id.value() : format_context->oformat->video_codec,
+    const enum AVCodecID video_codec_id =
+        codec_id ? codec_id.value() : format_context->oformat->video_codec;
+
+    // GIF would pick a fixed 8-bit RGB format otherwise.
+    CodecSettings settings = codec_settings;
+    if (settings.palette && !settings.pixel_format &&
+        video_codec_id == AV_CODEC_ID_GIF)
+        settings.pixel_format = AV_PIX_FMT_PAL8;
+    // Y4M only takes YUV frames, but its wrapped_avframe codec takes
+    // any format. The muxer is the one resolved from the format name
+    // or from the extension of the filename.
+    if (!settings.pixel_format &&
+        std::string(format_context->oformat->name) == "yuv4mpegpipe")
+        settings.pixel_format = AV_PIX_FMT_YUV420P;
+
+    std::function<Expected<std::shared_ptr<WrappedAvCodecContext>, Error>()>
+        codec_context_factory = [=]()
+    {
+        return WrappedAvCodecContext::create(
+            video_codec_id,
             bit_rate,
             width,
             height,
             frame_rate,
             source_pixel_format,
             codec_additional_flags,
-            parameters
+            parameters,
+            settings
         );
+    };
+
+    Expected<std::shared_ptr<WrappedAvCodecContext>, Error> codec_context =
+        codec_context_factory();
     if (!codec_context)
         return Unexpected<Error>(Error());
 
+    // The quantized frames skip the intermediate YUV420P conversion.
+    std::optional<PaletteSettings> palette;
+    if ((**codec_context.value())->pix_fmt == AV_PIX_FMT_PAL8)
+        palette = settings.palette;
+
     return std::shared_ptr<WrappedOutputVideoAvFormatContext>(
         new WrappedOutputVideoAvFormatContext(
             format_context,
             parameters,
+            codec_context_factory,
             codec_context.value(),
-            intermediate_yuv420p_conversion
+            intermediate_yuv420p_conversion && !palette,
+            palette,
+            io_context
         )
     );
 }
@@ -344,6 +679,12 @@ bool WrappedOutputVideoAvFormatContext::is_intermediate_yuv420p_conversion(
     return this->intermediate_yuv420p_conversion;
 }
 
+Expected<std::shared_ptr<WrappedAvCodecContext>, Error>
+    WrappedOutputVideoAvFormatContext::create_codec_context() const
+{
+    return this->codec_context_factory();
+}
+
 AVFormatContext *WrappedOutputVideoAvFormatContext::operator*()
 {
     return this->format_context;
@@ -369,7 +710,11 @@ Expected<void, Error> WrappedOutputVideoAvFormatContext::open()
     const std::string filename = this->format_context->url;
 
     // Open the output file, if needed.
-    if (!this->no_file())
+    if (this->io_context)
+    {
+        this->format_context->pb = **this->io_context;
+    }
+    else if (!this->no_file())
     {
         int result = avio_open(
             &this->format_context->pb, filename.c_str(), AVIO_FLAG_WRITE
@@ -389,7 +734,9 @@ Expected<void, Error> WrappedOutputVideoAvFormatContext::open()
     copied_parameters.dictionary = p_copied_parameters;
     if (result < 0)
     {
-        if (!this->no_file())
+        if (this->io_context)
+            this->format_context->pb = nullptr;
+        else if (!this->no_file())
             avio_closep(&this->format_context->pb);
         return Unexpected<Error>(Error());
     }
@@ -405,7 +752,11 @@ void WrappedOutputVideoAvFormatContext::close()
     {
         av_write_trailer(this->format_context);
 
-        if (!this->no_file())
+        if (this->io_context)
+            // The custom output is freed with the wrapped context,
+            // the trailer has already flushed it.
+            this->format_context->pb = nullptr;
+        else if (!this->no_file())
             // Close the output file.
             avio_closep(&this->format_context->pb);
 
@@ -421,19 +772,27 @@ bool WrappedOutputVideoAvFormatContext::no_file()
 WrappedOutputVideoAvFormatContext::WrappedOutputVideoAvFormatContext(
     AVFormatContext *format_context,
     WrappedAvDictionary parameters,
+    std::function<Expected<std::shared_ptr<WrappedAvCodecContext>, Error>()>
+        codec_context_factory,
     std::shared_ptr<WrappedAvCodecContext> codec_context,
-    const bool intermediate_yuv420p_conversion
+    const bool intermediate_yuv420p_conversion,
+    const std::optional<PaletteSettings> palette,
+    std::shared_ptr<WrappedAvIoContext> io_context
 )
     : format_context(format_context),
       parameters(parameters),
+      codec_context_factory(codec_context_factory),
       codec_context(codec_context),
       opened(false),
-      intermediate_yuv420p_conversion(intermediate_yuv420p_conversion)
+      intermediate_yuv420p_conversion(intermediate_yuv420p_conversion),
+      palette(palette),
+      io_context(io_context)
 {}
 
 Expected<std::shared_ptr<WrappedVideoAvStream>, Error>
     WrappedVideoAvStream::create_and_open_format_context(
-        std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context
+        std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context,
+        const bool repeat_frames_into_gaps
     )
 {
     if (format_context->is_opened())
@@ -461,11 +820,53 @@ Expected<std::shared_ptr<WrappedVideoAvStream>, Error>
     if (!frame)
         return Unexpected<Error>(Error());
 
+    const enum AVPixelFormat pixel_format_yuv420p = AV_PIX_FMT_YUV420P;
+    std::shared_ptr<WrappedAvFrame> frame_yuv420p;
+    if (format_context->is_intermediate_yuv420p_conversion() &&
+        codec_context->pix_fmt != pixel_format_yuv420p)
+    {
+        Expected<std::shared_ptr<WrappedAvFrame>, Error> tmp_frame_yuv420p =
+            WrappedAvFrame::create(
+                pixel_format_yuv420p,
+                codec_context->width,
+                codec_context->height
+            );
+        if (!tmp_frame_yuv420p)
+            return Unexpected<Error>(Error());
+        frame_yuv420p = tmp_frame_yuv420p.value();
+    }
+
+    Expected<std::shared_ptr<WrappedSwsContext>, Error> sws_context =
+        WrappedSwsContext::create();
+    if (!sws_context)
+        return Unexpected<Error>(Error());
+
+    Expected<std::shared_ptr<WrappedSwsContext>, Error> sws_context_yuv420p =
+        WrappedSwsContext::create();
+    if (!sws_context_yuv420p)
+        return Unexpected<Error>(Error());
+
     Expected<std::shared_ptr<WrappedAvPacket>, Error> packet =
         WrappedAvPacket::create();
     if (!packet)
         return Unexpected<Error>(Error());
 
+    std::shared_ptr<PaletteQuantizer> palette_quantizer;
+    if (format_context->palette)
+    {
+        Expected<std::shared_ptr<PaletteQuantizer>, Error>
+            tmp_palette_quantizer = PaletteQuantizer::create(
+                codec_context->width,
+                codec_context->height,
+                format_context->palette->segment_size,
+                format_context->palette->sample_size,
+                std::max(std::thread::hardware_concurrency(), 1u)
+            );
+        if (!tmp_palette_quantizer)
+            return Unexpected<Error>(Error());
+        palette_quantizer = tmp_palette_quantizer.value();
+    }
+
     // Print information about the stream to
     // the standard output.
     const std::string filename = (**format_context)->url;
@@ -476,7 +877,15 @@ Expected<std::shared_ptr<WrappedVideoAvStream>, Error>
     // the stream still exists.
     std::shared_ptr<WrappedVideoAvStream> wrapped_stream =
         std::shared_ptr<WrappedVideoAvStream>(new WrappedVideoAvStream(
-            format_context, stream, frame.value(), packet.value()
+            format_context,
+            stream,
+            frame.value(),
+            frame_yuv420p,
+            sws_context.value(),
+            sws_context_yuv420p.value(),
+            packet.value(),
+            palette_quantizer,
+            repeat_frames_into_gaps
         ));
 
     Expected<void, Error> open_result = format_context->open();
@@ -495,6 +904,27 @@ Expected<void, Error>
     if (!this->format_context->is_opened())
         return Unexpected<Error>(Error());
 
+    // The frames are buffered only until the palette of their segment
+    // is generated, the later ones are quantized right away.
+    if (this->palette_quantizer)
+    {
+        Expected<void, Error> add_result =
+            this->palette_quantizer->add_frame(**frame_in);
+        if (!add_result)
+            return Unexpected<Error>(Error());
+        if (this->palette_quantizer->has_palette() ||
+            this->palette_quantizer->is_sample_complete())
+            return this->write_palette_frames();
+        return Expected<void, Error>();
+    }
+
+    Expected<bool, Error> advance_result =
+        this->advance_timestamp((**frame_in)->pts);
+    if (!advance_result)
+        return Unexpected<Error>(Error());
+    if (!advance_result.value())
+        return Expected<void, Error>();
+
     int result;
 
     result = av_frame_make_writable(**this->frame);
@@ -502,29 +932,103 @@ Expected<void, Error>
         return Unexpected<Error>(Error());
 
     const enum AVPixelFormat pixel_format_yuv420p = AV_PIX_FMT_YUV420P;
-    if (this->format_context->is_intermediate_yuv420p_conversion() &&
-        (**this->frame)->format != pixel_format_yuv420p)
+    if (this->frame_yuv420p && (**frame_in)->format != pixel_format_yuv420p)
     {
-        Expected<std::shared_ptr<WrappedAvFrame>, Error> tmp_frame_yuv420p =
-            WrappedAvFrame::create(
-                pixel_format_yuv420p, (**frame_in)->width, (**frame_in)->height
+        Expected<void, Error> convert_result =
+            this->frame_yuv420p->convert_and_copy(
+                *frame_in, *this->sws_context
             );
-        if (!tmp_frame_yuv420p)
+        if (!convert_result)
+            return Unexpected<Error>(Error());
+        convert_result = this->frame->convert_and_copy(
+            *this->frame_yuv420p, *this->sws_context_yuv420p
+        );
+        if (!convert_result)
             return Unexpected<Error>(Error());
-        (tmp_frame_yuv420p.value())->convert_and_copy(*frame_in);
-        this->frame->convert_and_copy(*tmp_frame_yuv420p.value());
     }
     else
     {
-        this->frame->convert_and_copy(*frame_in);
+        Expected<void, Error> convert_result =
+            this->frame->convert_and_copy(*frame_in, *this->sws_context);
+        if (!convert_result)
+            return Unexpected<Error>(Error());
     }
 
+    return this->encode_frame();
+}
+
+Expected<bool, Error> WrappedVideoAvStream::advance_timestamp(int64_t timestamp)
+{
+    // Timestamps must increase, so a frame which falls on
+    // (or before) the previous frame is dropped.
+    if (timestamp == AV_NOPTS_VALUE)
+        timestamp = this->timestamp;
+    if (timestamp < this->timestamp)
+        return false;
+
+    // The previous frame is still in the frame. The timestamp is only
+    // above 0 if a frame has been written already.
+    if (this->repeat_frames_into_gaps && this->timestamp > 0)
+    {
+        while (this->timestamp < timestamp)
+        {
+            Expected<void, Error> encode_result = this->encode_frame();
+            if (!encode_result)
+                return Unexpected<Error>(Error());
+        }
+    }
+    this->timestamp = timestamp;
+
+    return true;
+}
+
+Expected<void, Error> WrappedVideoAvStream::write_palette_frames()
+{
+    if (!this->palette_quantizer->has_palette())
+        this->palette_quantizer->generate_palette();
+
+    for (size_t i = 0; i < this->palette_quantizer->get_frame_count(); ++i)
+    {
+        Expected<bool, Error> advance_result = this->advance_timestamp(
+            this->palette_quantizer->get_frame_timestamp(i)
+        );
+        if (!advance_result)
+            return Unexpected<Error>(Error());
+        if (!advance_result.value())
+            continue;
+
+        int result = av_frame_make_writable(**this->frame);
+        if (result < 0)
+            return Unexpected<Error>(Error());
+
+        this->palette_quantizer->quantize_frame(i, **this->frame);
+
+        Expected<void, Error> encode_result = this->encode_frame();
+        if (!encode_result)
+            return Unexpected<Error>(Error());
+    }
+
+    this->palette_quantizer->clear();
+    return Expected<void, Error>();
+}
+
+Expected<void, Error> WrappedVideoAvStream::encode_frame()
+{
     (**(this->frame))->pts = this->timestamp;
 
+    if (this->is_raw())
+    {
+        Expected<void, Error> write_result = this->write_raw_frame();
+        if (!write_result)
+            return Unexpected<Error>(Error());
+        ++this->timestamp;
+        return Expected<void, Error>();
+    }
+
     AVCodecContext *codec_context = **(this->format_context->codec_context);
 
     // Send the frame to the encoder.
-    result = avcodec_send_frame(codec_context, **(this->frame));
+    int result = avcodec_send_frame(codec_context, **(this->frame));
     if (result < 0)
         return Unexpected<Error>(Error());
 
@@ -537,6 +1041,127 @@ Expected<void, Error>
     return Expected<void, Error>();
 }
 
+bool WrappedVideoAvStream::is_raw() const
+{
+    const enum AVCodecID codec_id = this->stream->codecpar->codec_id;
+    return codec_id == AV_CODEC_ID_RAWVIDEO ||
+           codec_id == AV_CODEC_ID_WRAPPED_AVFRAME;
+}
+
+static void free_wrapped_av_frame(void *, uint8_t *data)
+{
+    AVFrame *frame = reinterpret_cast<AVFrame *>(data);
+    av_frame_free(&frame);
+}
+
+Expected<void, Error> WrappedVideoAvStream::write_raw_frame()
+{
+    AVFrame *frame = **(this->frame);
+    AVPacket *packet = **(this->packet);
+
+    if (this->stream->codecpar->codec_id == AV_CODEC_ID_RAWVIDEO)
+    {
+        // The packet holds the frame data without any padding.
+        const enum AVPixelFormat pixel_format =
+            static_cast<enum AVPixelFormat>(frame->format);
+        const int size = av_image_get_buffer_size(
+            pixel_format, frame->width, frame->height, 1
+        );
+        if (size < 0)
+            return Unexpected<Error>(Error());
+
+        int result = av_new_packet(packet, size);
+        if (result < 0)
+            return Unexpected<Error>(Error());
+
+        result = av_image_copy_to_buffer(
+            packet->data,
+            size,
+            frame->data,
+            frame->linesize,
+            pixel_format,
+            frame->width,
+            frame->height,
+            1
+        );
+        if (result < 0)
+        {
+            av_packet_unref(packet);
+            return Unexpected<Error>(Error());
+        }
+    }
+    else
+    {
+        // The packet holds a reference to the frame itself,
+        // the same way as the wrapped_avframe codec does it.
+        AVFrame *cloned_frame = av_frame_clone(frame);
+        if (!cloned_frame)
+            return Unexpected<Error>(Error());
+
+        packet->buf = av_buffer_create(
+            reinterpret_cast<uint8_t *>(cloned_frame),
+            sizeof(*cloned_frame),
+            free_wrapped_av_frame,
+            nullptr,
+            0
+        );
+        if (!packet->buf)
+        {
+            av_frame_free(&cloned_frame);
+            return Unexpected<Error>(Error());
+        }
+        packet->data = packet->buf->data;
+        packet->size = sizeof(*cloned_frame);
+    }
+
+    packet->pts = this->timestamp;
+    packet->dts = this->timestamp;
+    packet->duration = 1;
+    packet->flags |= AV_PKT_FLAG_KEY;
+
+    return this->write_packet(packet);
+}
+
+Expected<void, Error> WrappedVideoAvStream::write_encoded_packet(
+    std::shared_ptr<WrappedAvPacket> packet, const int64_t timestamp_offset
+)
+{
+    if (!packet)
+        return Unexpected<Error>(Error());
+
+    if (!this->format_context->is_opened())
+        return Unexpected<Error>(Error());
+
+    AVPacket *av_packet = **packet;
+    if (av_packet->pts != AV_NOPTS_VALUE)
+        av_packet->pts += timestamp_offset;
+    if (av_packet->dts != AV_NOPTS_VALUE)
+        av_packet->dts += timestamp_offset;
+
+    return this->write_packet(av_packet);
+}
+
+Expected<void, Error> WrappedVideoAvStream::write_packet(AVPacket *packet)
+{
+    AVCodecContext *codec_context = **(this->format_context->codec_context);
+
+    // Rescale output packet timestamp values from codec to stream timebase.
+    av_packet_rescale_ts(
+        packet, codec_context->time_base, this->stream->time_base
+    );
+    packet->stream_index = this->stream->index;
+
+    // Write the compressed frame to the media file.
+    int result = av_interleaved_write_frame(**(this->format_context), packet);
+    // The packet is now blank (av_interleaved_write_frame() takes ownership
+    // of its contents and resets packet), so that no unreferencing is
+    // necessary. This would be different if one used av_write_frame().
+    if (result < 0)
+        return Unexpected<Error>(Error());
+
+    return Expected<void, Error>();
+}
+
 Expected<void, Error> WrappedVideoAvStream::enter_codec_flush_mode()
 {
     AVCodecContext *codec_context = **(this->format_context->codec_context);
@@ -572,18 +1197,8 @@ Expected<void, Error> WrappedVideoAvStream::receive_packet()
                 return Unexpected<Error>(Error());
         }
 
-        // Rescale output packet timestamp values from codec to stream timebase.
-        av_packet_rescale_ts(
-            packet, codec_context->time_base, this->stream->time_base
-        );
-        packet->stream_index = this->stream->index;
-
-        // Write the compressed frame to the media file.
-        result = av_interleaved_write_frame(**(this->format_context), packet);
-        // The packet is now blank (av_interleaved_write_frame() takes ownership
-        // of its contents and resets packet), so that no unreferencing is
-        // necessary. This would be different if one used av_write_frame().
-        if (result < 0)
+        Expected<void, Error> write_result = this->write_packet(packet);
+        if (!write_result)
             return Unexpected<Error>(Error());
     }
     return Expected<void, Error>();
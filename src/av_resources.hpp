@@ -1,16 +1,23 @@
+#ifndef ELEMENTARY_VISUALIZER_AV_RESOURCES_HPP
+#define ELEMENTARY_VISUALIZER_AV_RESOURCES_HPP
+
 #include <elementary_visualizer/elementary_visualizer.hpp>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
 #include <tl/expected.hpp>
+#include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavutil/avassert.h>
 #include <libavutil/channel_layout.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/mathematics.h>
 #include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
 #include <libavutil/timestamp.h>
 #include <libswresample/swresample.h>
 #include <libswscale/swscale.h>
@@ -52,6 +59,31 @@ private:
     AVPacket *packet;
 };
 
+class WrappedSwsContext
+{
+public:
+
+    static Expected<std::shared_ptr<WrappedSwsContext>, Error> create();
+
+    // Scales and converts the source into the destination.
+    // The underlying context is created on the first call, and recreated
+    // only if the sizes or formats of the frames change.
+    Expected<void, Error> scale(const AVFrame *source, AVFrame *destination);
+
+    ~WrappedSwsContext();
+
+    WrappedSwsContext(WrappedSwsContext &&other) = delete;
+    WrappedSwsContext &operator=(WrappedSwsContext &&other) = delete;
+    WrappedSwsContext(const WrappedSwsContext &other) = delete;
+    WrappedSwsContext &operator=(const WrappedSwsContext &other) = delete;
+
+private:
+
+    WrappedSwsContext();
+
+    struct SwsContext *sws_context;
+};
+
 class WrappedAvFrame
 {
 public:
@@ -65,7 +97,9 @@ public:
     AVFrame *operator*();
     const AVFrame *operator*() const;
 
-    Expected<void, Error> convert_and_copy(const WrappedAvFrame &source);
+    Expected<void, Error> convert_and_copy(
+        const WrappedAvFrame &source, WrappedSwsContext &sws_context
+    );
 
     ~WrappedAvFrame();
 
@@ -76,6 +110,48 @@ private:
     AVFrame *frame;
 };
 
+// Settings of the direct quantization of the frames into PAL8 frames.
+struct PaletteSettings
+{
+    // Number of frames which share a palette. With 0, the whole video
+    // is one segment.
+    unsigned int segment_size;
+    // Number of frames at the start of each segment which its palette
+    // is generated from. Only these are buffered, the later frames
+    // of the segment are quantized as they arrive.
+    unsigned int sample_size;
+};
+
+// Encoder settings which are set directly on the codec context,
+// instead of through the codec parameters.
+struct CodecSettings
+{
+    // Maximum distance between two intra frames.
+    int gop_size = 12;
+    // Maximum number of consecutive B-frames. If it is not set,
+    // MPEG-2 uses 2 and every other codec uses the codec default.
+    std::optional<int> max_b_frames = std::nullopt;
+    // If set, the bit rate is ignored, and the codec encodes with
+    // constant quality (CRF if the codec supports it, otherwise
+    // a fixed quantizer scale).
+    std::optional<float> constant_quality = std::nullopt;
+    // If set, the codec uses this pixel format. Otherwise the best match
+    // for the source pixel format among the ones supported by the codec,
+    // or the source pixel format itself if the codec takes any format.
+    std::optional<enum AVPixelFormat> pixel_format = std::nullopt;
+    // With 0, FFmpeg picks the thread count based on the cores.
+    int thread_count = 1;
+    int thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    // If set, the timestamps are in this time base
+    // instead of the frame rate units.
+    std::optional<AVRational> time_base = std::nullopt;
+    // If set, and the codec takes PAL8 frames (which GIF does
+    // unless an other pixel format is set), the frames are quantized
+    // directly from RGB with a palette for each segment,
+    // instead of being converted by swscale.
+    std::optional<PaletteSettings> palette = std::nullopt;
+};
+
 class WrappedAvCodecContext
 {
 public:
@@ -88,7 +164,8 @@ public:
         const unsigned int frame_rate,
         const enum AVPixelFormat source_pixel_format,
         const int additional_flags,
-        const WrappedAvDictionary &parameters
+        const WrappedAvDictionary &parameters,
+        const CodecSettings &settings = CodecSettings()
     );
 
     AVCodecContext *operator*();
@@ -103,7 +180,67 @@ private:
     AVCodecContext *codec_context;
 };
 
+// Output which is written through callbacks instead of a file.
+class WrappedAvIoContext
+{
+public:
+
+    using WriteCallback = std::function<bool(const uint8_t *, size_t)>;
+
+    // Every write is passed to the callback. This is not seekable.
+    static Expected<std::shared_ptr<WrappedAvIoContext>, Error>
+        create(WriteCallback write_callback, const size_t buffer_size);
+    // Writes into the growable memory, which is also seekable.
+    // The memory is cleared first.
+    static Expected<std::shared_ptr<WrappedAvIoContext>, Error> create(
+        std::shared_ptr<std::vector<uint8_t>> memory, const size_t buffer_size
+    );
+    // Writes into the file (or other protocol) of the url, passing on
+    // only full buffers. It is seekable if the output is seekable.
+    static Expected<std::shared_ptr<WrappedAvIoContext>, Error>
+        create(const std::string &url, const size_t buffer_size);
+
+    AVIOContext *operator*();
+    const AVIOContext *operator*() const;
+
+    ~WrappedAvIoContext();
+
+    WrappedAvIoContext(WrappedAvIoContext &&other) = delete;
+    WrappedAvIoContext &operator=(WrappedAvIoContext &&other) = delete;
+    WrappedAvIoContext(const WrappedAvIoContext &) = delete;
+    WrappedAvIoContext &operator=(const WrappedAvIoContext &) = delete;
+
+private:
+
+    WrappedAvIoContext(
+        WriteCallback write_callback,
+        std::shared_ptr<std::vector<uint8_t>> memory,
+        AVIOContext *url_io_context
+    );
+
+    // The callbacks get the wrapped context as their opaque pointer,
+    // so the AVIOContext is allocated after the wrapped context.
+    static Expected<std::shared_ptr<WrappedAvIoContext>, Error>
+        allocate_io_context(
+            std::shared_ptr<WrappedAvIoContext> wrapped_io_context,
+            const size_t buffer_size
+        );
+
+    static int write_packet(void *opaque, uint8_t *buffer, int buffer_size);
+    static int64_t seek(void *opaque, int64_t offset, int whence);
+
+    const WriteCallback write_callback;
+    std::shared_ptr<std::vector<uint8_t>> memory;
+    // Position of the next write in the memory.
+    size_t position;
+    // Unbuffered output of the url.
+    AVIOContext *url_io_context;
+
+    AVIOContext *io_context;
+};
+
 class WrappedOutputVideoAvFormatContext;
+class PaletteQuantizer;
 
 class WrappedVideoAvStream
 {
@@ -111,13 +248,23 @@ public:
 
     static Expected<std::shared_ptr<WrappedVideoAvStream>, Error>
         create_and_open_format_context(
-            std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context
+            std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context,
+            const bool repeat_frames_into_gaps = false
         );
 
     AVStream *operator*();
     const AVStream *operator*() const;
 
+    // If the pts of the frame is set, the frame is written at that
+    // timestamp, otherwise right after the previous frame.
+    // Frames not after the previous frame are dropped.
     Expected<void, Error> write_frame(std::shared_ptr<WrappedAvFrame> frame);
+    // Writes a packet which was encoded by an other codec context of
+    // the format context. Its timestamps are in the codec time base,
+    // and they are shifted by the offset.
+    Expected<void, Error> write_encoded_packet(
+        std::shared_ptr<WrappedAvPacket> packet, const int64_t timestamp_offset
+    );
 
     ~WrappedVideoAvStream();
 
@@ -127,18 +274,52 @@ private:
         std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context,
         AVStream *stream,
         std::shared_ptr<WrappedAvFrame> frame,
-        std::shared_ptr<WrappedAvPacket> packet
+        std::shared_ptr<WrappedAvFrame> frame_yuv420p,
+        std::shared_ptr<WrappedSwsContext> sws_context,
+        std::shared_ptr<WrappedSwsContext> sws_context_yuv420p,
+        std::shared_ptr<WrappedAvPacket> packet,
+        std::shared_ptr<PaletteQuantizer> palette_quantizer,
+        const bool repeat_frames_into_gaps
     );
 
+    // Moves the timestamp to the one of the next frame, repeating
+    // the previous frame into the gap if needed. Returns false
+    // if the next frame is dropped.
+    Expected<bool, Error> advance_timestamp(int64_t timestamp);
+    // Encodes the frame at the timestamp, and moves on to the next one.
+    Expected<void, Error> encode_frame();
+    // Quantizes and encodes the frames buffered by the palette quantizer,
+    // generating their palette first if it is not generated yet.
+    Expected<void, Error> write_palette_frames();
+    // Raw frames (rawvideo and wrapped_avframe) are written into packets
+    // directly, without going through the codec.
+    bool is_raw() const;
+    Expected<void, Error> write_raw_frame();
+    Expected<void, Error> write_packet(AVPacket *packet);
     Expected<void, Error> receive_packet();
     Expected<void, Error> enter_codec_flush_mode();
 
     std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context;
     AVStream *stream;
     std::shared_ptr<WrappedAvFrame> frame;
+    // Preallocated frame for the intermediate YUV420P conversion,
+    // nullptr if the codec takes YUV420P frames directly.
+    std::shared_ptr<WrappedAvFrame> frame_yuv420p;
+    // Converts the written frames into the frame, or into the frame_yuv420p
+    // if there is an intermediate YUV420P conversion.
+    std::shared_ptr<WrappedSwsContext> sws_context;
+    // Converts the frame_yuv420p into the frame.
+    std::shared_ptr<WrappedSwsContext> sws_context_yuv420p;
     std::shared_ptr<WrappedAvPacket> packet;
+    // Quantizes the written frames into the frame instead of
+    // the sws contexts, nullptr if the frames are converted by them.
+    std::shared_ptr<PaletteQuantizer> palette_quantizer;
     bool is_state_eof;
 
+    // If set, the previous frame is repeated at the timestamps
+    // skipped by the written frames, to keep a constant frame rate.
+    const bool repeat_frames_into_gaps;
+
     // Presentation timestamp in time_base units.
     int64_t timestamp;
 };
@@ -158,12 +339,20 @@ public:
             const enum AVPixelFormat source_pixel_format,
             const WrappedAvDictionary &parameters,
             const std::optional<enum AVCodecID> codec_id = std::nullopt,
-            const bool intermediate_yuv420p_conversion = true
+            const bool intermediate_yuv420p_conversion = true,
+            const CodecSettings &codec_settings = CodecSettings(),
+            std::shared_ptr<WrappedAvIoContext> io_context = nullptr
         );
 
     bool is_opened() const;
     bool is_intermediate_yuv420p_conversion() const;
 
+    // Creates a new codec context with the same settings as the codec
+    // context of the output, so that its packets can be muxed
+    // into the output.
+    Expected<std::shared_ptr<WrappedAvCodecContext>, Error>
+        create_codec_context() const;
+
     AVFormatContext *operator*();
     const AVFormatContext *operator*() const;
 
@@ -179,16 +368,30 @@ private:
     WrappedOutputVideoAvFormatContext(
         AVFormatContext *format_context,
         WrappedAvDictionary parameters,
+        std::function<
+            Expected<std::shared_ptr<WrappedAvCodecContext>, Error>()>
+            codec_context_factory,
         std::shared_ptr<WrappedAvCodecContext> codec_context,
-        const bool intermediate_yuv420p_conversion
+        const bool intermediate_yuv420p_conversion,
+        const std::optional<PaletteSettings> palette,
+        std::shared_ptr<WrappedAvIoContext> io_context
     );
 
     AVFormatContext *format_context;
     const WrappedAvDictionary parameters;
+    const std::function<
+        Expected<std::shared_ptr<WrappedAvCodecContext>, Error>()>
+        codec_context_factory;
     std::shared_ptr<WrappedAvCodecContext> codec_context;
     bool opened;
     const bool intermediate_yuv420p_conversion;
+    // Set if the frames are quantized by a palette quantizer.
+    const std::optional<PaletteSettings> palette;
+    // If not nullptr, the output is written into this instead of the file.
+    std::shared_ptr<WrappedAvIoContext> io_context;
 
     friend class WrappedVideoAvStream;
 };
 }
+
+#endif
@@ -20,18 +20,27 @@ Expected<std::shared_ptr<WrappedGlfwWindow>, Error> Entity::create_window(
 }
 
 Expected<std::shared_ptr<GlTexture>, Error> Entity::create_texture(
-    const glm::uvec2 &size, const bool depth, const std::optional<int> samples
+    const glm::uvec2 &size,
+    const bool depth,
+    const std::optional<int> samples,
+    const std::optional<GLint> internalformat
 )
 {
-    return GlTexture::create(this->glfw_window, size, depth, samples);
+    return GlTexture::create(
+        this->glfw_window, size, depth, samples, internalformat
+    );
 }
 
 Expected<std::shared_ptr<GlFramebufferTexture>, Error>
     Entity::create_framebuffer_texture(
-        const glm::uvec2 &size, const std::optional<int> samples
+        const glm::uvec2 &size,
+        const std::optional<int> samples,
+        const std::optional<GLint> internalformat
     )
 {
-    return GlFramebufferTexture::create(this->glfw_window, size, samples);
+    return GlFramebufferTexture::create(
+        this->glfw_window, size, samples, internalformat
+    );
 }
 
 Expected<std::shared_ptr<GlLinesegments>, Error> Entity::create_linesegments(
@@ -53,6 +62,28 @@ Expected<std::shared_ptr<GlSurface>, Error>
     return GlSurface::create(this->glfw_window, surface_data);
 }
 
+Expected<std::shared_ptr<GlShaderBuffer>, Error> Entity::create_shader_buffer()
+{
+    return GlShaderBuffer::create(this->glfw_window);
+}
+
+Expected<std::shared_ptr<GlPixelBuffer>, Error>
+    Entity::create_pixel_buffer(const size_t size)
+{
+    return GlPixelBuffer::create(this->glfw_window, size);
+}
+
+Expected<std::shared_ptr<GlFence>, Error> Entity::create_fence()
+{
+    return GlFence::create(this->glfw_window);
+}
+
+Expected<std::shared_ptr<GlQuery>, Error>
+    Entity::create_query(const GLenum target)
+{
+    return GlQuery::create(this->glfw_window, target);
+}
+
 void Entity::make_current_context()
 {
     this->glfw_window->make_current_context();
@@ -60,6 +91,24 @@ void Entity::make_current_context()
 
 Entity::~Entity() {}
 
+// Links the shader program of a visual with the snippets which
+// store its fragments for the transparency modes. Only the A-buffer
+// variant has the A-buffer snippet.
+static Expected<std::shared_ptr<GlShaderProgram>, Error>
+    create_visual_shader_program(
+        std::shared_ptr<WrappedGlfwWindow> glfw_window,
+        std::vector<GlShaderSource> shader_sources,
+        const bool a_buffer
+    )
+{
+    shader_sources.push_back(depth_peeling_fragment_shader_source());
+    shader_sources.push_back(
+        a_buffer ? a_buffer_fragment_shader_source()
+                 : a_buffer_stub_fragment_shader_source()
+    );
+    return GlShaderProgram::create(glfw_window, shader_sources);
+}
+
 Expected<std::shared_ptr<Entity>, Error> Entity::initialize()
 {
     Expected<std::shared_ptr<WrappedGlfwWindow>, Error> window_creation_result =
@@ -106,23 +155,72 @@ Expected<std::shared_ptr<Entity>, Error> Entity::initialize()
             if (!quad_multisampled_shader_program)
                 return Unexpected<Error>(Error());
 
-            std::vector<GlShaderSource> circle_shader_sources;
-            circle_shader_sources.push_back(
-                depth_peeling_fragment_shader_source()
+            std::vector<GlShaderSource>
+                weighted_blended_composite_shader_sources;
+            weighted_blended_composite_shader_sources.push_back(
+                quad_vertex_shader_source()
+            );
+            weighted_blended_composite_shader_sources.push_back(
+                weighted_blended_composite_fragment_shader_source()
             );
+            Expected<std::shared_ptr<GlShaderProgram>, Error>
+                weighted_blended_composite_shader_program(
+                    GlShaderProgram::create(
+                        glfw_window, weighted_blended_composite_shader_sources
+                    )
+                );
+            if (!weighted_blended_composite_shader_program)
+                return Unexpected<Error>(Error());
+
+            std::vector<GlShaderSource>
+                weighted_blended_composite_multisampled_shader_sources;
+            weighted_blended_composite_multisampled_shader_sources.push_back(
+                quad_vertex_shader_source()
+            );
+            weighted_blended_composite_multisampled_shader_sources.push_back(
+                weighted_blended_composite_multisampled_fragment_shader_source()
+            );
+            Expected<std::shared_ptr<GlShaderProgram>, Error>
+                weighted_blended_composite_multisampled_shader_program(
+                    GlShaderProgram::create(
+                        glfw_window,
+                        weighted_blended_composite_multisampled_shader_sources
+                    )
+                );
+            if (!weighted_blended_composite_multisampled_shader_program)
+                return Unexpected<Error>(Error());
+
+            std::vector<GlShaderSource> a_buffer_resolve_shader_sources;
+            a_buffer_resolve_shader_sources.push_back(
+                quad_vertex_shader_source()
+            );
+            a_buffer_resolve_shader_sources.push_back(
+                a_buffer_resolve_fragment_shader_source()
+            );
+            Expected<std::shared_ptr<GlShaderProgram>, Error>
+                a_buffer_resolve_shader_program(GlShaderProgram::create(
+                    glfw_window, a_buffer_resolve_shader_sources
+                ));
+            if (!a_buffer_resolve_shader_program)
+                return Unexpected<Error>(Error());
+
+            std::vector<GlShaderSource> circle_shader_sources;
             circle_shader_sources.push_back(circle_vertex_shader_source());
             circle_shader_sources.push_back(circle_fragment_shader_source());
             Expected<std::shared_ptr<GlShaderProgram>, Error>
-                circle_shader_program(
-                    GlShaderProgram::create(glfw_window, circle_shader_sources)
-                );
+                circle_shader_program(create_visual_shader_program(
+                    glfw_window, circle_shader_sources, false
+                ));
             if (!circle_shader_program)
                 return Unexpected<Error>(Error());
+            Expected<std::shared_ptr<GlShaderProgram>, Error>
+                circle_a_buffer_shader_program(create_visual_shader_program(
+                    glfw_window, circle_shader_sources, true
+                ));
+            if (!circle_a_buffer_shader_program)
+                return Unexpected<Error>(Error());
 
             std::vector<GlShaderSource> linesegments_shader_sources;
-            linesegments_shader_sources.push_back(
-                depth_peeling_fragment_shader_source()
-            );
             linesegments_shader_sources.push_back(
                 line_cap_geometry_shader_source()
             );
@@ -136,38 +234,63 @@ Expected<std::shared_ptr<Entity>, Error> Entity::initialize()
                 linesegments_fragment_shader_source()
             );
             Expected<std::shared_ptr<GlShaderProgram>, Error>
-                linesegments_shader_program(GlShaderProgram::create(
-                    glfw_window, linesegments_shader_sources
+                linesegments_shader_program(create_visual_shader_program(
+                    glfw_window, linesegments_shader_sources, false
                 ));
             if (!linesegments_shader_program)
                 return Unexpected<Error>(Error());
+            Expected<std::shared_ptr<GlShaderProgram>, Error>
+                linesegments_a_buffer_shader_program(
+                    create_visual_shader_program(
+                        glfw_window, linesegments_shader_sources, true
+                    )
+                );
+            if (!linesegments_a_buffer_shader_program)
+                return Unexpected<Error>(Error());
 
             std::vector<GlShaderSource> lines_shader_sources;
-            lines_shader_sources.push_back(depth_peeling_fragment_shader_source(
-            ));
             lines_shader_sources.push_back(line_cap_geometry_shader_source());
             lines_shader_sources.push_back(lines_vertex_shader_source());
             lines_shader_sources.push_back(lines_geometry_shader_source());
             lines_shader_sources.push_back(lines_fragment_shader_source());
             Expected<std::shared_ptr<GlShaderProgram>, Error>
-                lines_shader_program(
-                    GlShaderProgram::create(glfw_window, lines_shader_sources)
-                );
+                lines_shader_program(create_visual_shader_program(
+                    glfw_window, lines_shader_sources, false
+                ));
             if (!lines_shader_program)
                 return Unexpected<Error>(Error());
+            Expected<std::shared_ptr<GlShaderProgram>, Error>
+                lines_a_buffer_shader_program(create_visual_shader_program(
+                    glfw_window, lines_shader_sources, true
+                ));
+            if (!lines_a_buffer_shader_program)
+                return Unexpected<Error>(Error());
 
             std::vector<GlShaderSource> surface_shader_sources;
-            surface_shader_sources.push_back(
-                depth_peeling_fragment_shader_source()
-            );
             surface_shader_sources.push_back(surface_vertex_shader_source());
             surface_shader_sources.push_back(surface_fragment_shader_source());
             Expected<std::shared_ptr<GlShaderProgram>, Error>
-                surface_shader_program(
-                    GlShaderProgram::create(glfw_window, surface_shader_sources)
-                );
+                surface_shader_program(create_visual_shader_program(
+                    glfw_window, surface_shader_sources, false
+                ));
             if (!surface_shader_program)
                 return Unexpected<Error>(Error());
+            Expected<std::shared_ptr<GlShaderProgram>, Error>
+                surface_a_buffer_shader_program(create_visual_shader_program(
+                    glfw_window, surface_shader_sources, true
+                ));
+            if (!surface_a_buffer_shader_program)
+                return Unexpected<Error>(Error());
+
+            std::vector<GlShaderSource> yuv420p_shader_sources;
+            yuv420p_shader_sources.push_back(quad_vertex_shader_source());
+            yuv420p_shader_sources.push_back(yuv420p_fragment_shader_source());
+            Expected<std::shared_ptr<GlShaderProgram>, Error>
+                yuv420p_shader_program(
+                    GlShaderProgram::create(glfw_window, yuv420p_shader_sources)
+                );
+            if (!yuv420p_shader_program)
+                return Unexpected<Error>(Error());
 
             return std::shared_ptr<Entity>(new Entity(
                 glfw_window,
@@ -175,10 +298,18 @@ Expected<std::shared_ptr<Entity>, Error> Entity::initialize()
                 circle.value(),
                 quad_shader_program.value(),
                 quad_multisampled_shader_program.value(),
+                weighted_blended_composite_shader_program.value(),
+                weighted_blended_composite_multisampled_shader_program.value(),
+                a_buffer_resolve_shader_program.value(),
                 circle_shader_program.value(),
+                circle_a_buffer_shader_program.value(),
                 linesegments_shader_program.value(),
+                linesegments_a_buffer_shader_program.value(),
                 lines_shader_program.value(),
-                surface_shader_program.value()
+                lines_a_buffer_shader_program.value(),
+                surface_shader_program.value(),
+                surface_a_buffer_shader_program.value(),
+                yuv420p_shader_program.value()
             ));
         }
     );
@@ -190,19 +321,42 @@ Entity::Entity(
     std::shared_ptr<GlCircle> circle,
     std::shared_ptr<GlShaderProgram> quad_shader_program,
     std::shared_ptr<GlShaderProgram> quad_multisampled_shader_program,
+    std::shared_ptr<GlShaderProgram> weighted_blended_composite_shader_program,
+    std::shared_ptr<GlShaderProgram>
+        weighted_blended_composite_multisampled_shader_program,
+    std::shared_ptr<GlShaderProgram> a_buffer_resolve_shader_program,
     std::shared_ptr<GlShaderProgram> circle_shader_program,
+    std::shared_ptr<GlShaderProgram> circle_a_buffer_shader_program,
     std::shared_ptr<GlShaderProgram> linesegments_shader_program,
+    std::shared_ptr<GlShaderProgram> linesegments_a_buffer_shader_program,
     std::shared_ptr<GlShaderProgram> lines_shader_program,
-    std::shared_ptr<GlShaderProgram> surface_shader_program
+    std::shared_ptr<GlShaderProgram> lines_a_buffer_shader_program,
+    std::shared_ptr<GlShaderProgram> surface_shader_program,
+    std::shared_ptr<GlShaderProgram> surface_a_buffer_shader_program,
+    std::shared_ptr<GlShaderProgram> yuv420p_shader_program
 )
     : glfw_window(glfw_window),
       quad(quad),
       circle(circle),
       quad_shader_program(quad_shader_program),
       quad_multisampled_shader_program(quad_multisampled_shader_program),
+      weighted_blended_composite_shader_program(
+          weighted_blended_composite_shader_program
+      ),
+      weighted_blended_composite_multisampled_shader_program(
+          weighted_blended_composite_multisampled_shader_program
+      ),
+      a_buffer_resolve_shader_program(a_buffer_resolve_shader_program),
       circle_shader_program(circle_shader_program),
+      circle_a_buffer_shader_program(circle_a_buffer_shader_program),
       linesegments_shader_program(linesegments_shader_program),
+      linesegments_a_buffer_shader_program(
+          linesegments_a_buffer_shader_program
+      ),
       lines_shader_program(lines_shader_program),
-      surface_shader_program(surface_shader_program)
+      lines_a_buffer_shader_program(lines_a_buffer_shader_program),
+      surface_shader_program(surface_shader_program),
+      surface_a_buffer_shader_program(surface_a_buffer_shader_program),
+      yuv420p_shader_program(yuv420p_shader_program)
 {}
 }
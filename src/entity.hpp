@@ -24,11 +24,14 @@ public:
     Expected<std::shared_ptr<GlTexture>, Error> create_texture(
         const glm::uvec2 &size,
         const bool depth,
-        const std::optional<int> samples
+        const std::optional<int> samples,
+        const std::optional<GLint> internalformat = std::nullopt
     );
     Expected<std::shared_ptr<GlFramebufferTexture>, Error>
         create_framebuffer_texture(
-            const glm::uvec2 &size, const std::optional<int> samples
+            const glm::uvec2 &size,
+            const std::optional<int> samples,
+            const std::optional<GLint> internalformat = std::nullopt
         );
     Expected<std::shared_ptr<GlLinesegments>, Error>
         create_linesegments(const std::vector<Linesegment> &linesegments_data);
@@ -36,6 +39,11 @@ public:
         create_lines(const std::vector<Vertex> &lines_data);
     Expected<std::shared_ptr<GlSurface>, Error>
         create_surface(const SurfaceData &surface_data);
+    Expected<std::shared_ptr<GlShaderBuffer>, Error> create_shader_buffer();
+    Expected<std::shared_ptr<GlPixelBuffer>, Error>
+        create_pixel_buffer(const size_t size);
+    Expected<std::shared_ptr<GlFence>, Error> create_fence();
+    Expected<std::shared_ptr<GlQuery>, Error> create_query(const GLenum target);
 
     void make_current_context();
 
@@ -56,10 +64,20 @@ private:
         std::shared_ptr<GlCircle> circle,
         std::shared_ptr<GlShaderProgram> quad_shader_program,
         std::shared_ptr<GlShaderProgram> quad_multisampled_shader_program,
+        std::shared_ptr<GlShaderProgram>
+            weighted_blended_composite_shader_program,
+        std::shared_ptr<GlShaderProgram>
+            weighted_blended_composite_multisampled_shader_program,
+        std::shared_ptr<GlShaderProgram> a_buffer_resolve_shader_program,
         std::shared_ptr<GlShaderProgram> circle_shader_program,
+        std::shared_ptr<GlShaderProgram> circle_a_buffer_shader_program,
         std::shared_ptr<GlShaderProgram> linesegments_shader_program,
+        std::shared_ptr<GlShaderProgram> linesegments_a_buffer_shader_program,
         std::shared_ptr<GlShaderProgram> lines_shader_program,
-        std::shared_ptr<GlShaderProgram> surface_shader_program
+        std::shared_ptr<GlShaderProgram> lines_a_buffer_shader_program,
+        std::shared_ptr<GlShaderProgram> surface_shader_program,
+        std::shared_ptr<GlShaderProgram> surface_a_buffer_shader_program,
+        std::shared_ptr<GlShaderProgram> yuv420p_shader_program
     );
 
     std::shared_ptr<WrappedGlfwWindow> glfw_window;
@@ -70,10 +88,23 @@ public:
     const std::shared_ptr<GlCircle> circle;
     const std::shared_ptr<GlShaderProgram> quad_shader_program;
     const std::shared_ptr<GlShaderProgram> quad_multisampled_shader_program;
+    const std::shared_ptr<GlShaderProgram>
+        weighted_blended_composite_shader_program;
+    const std::shared_ptr<GlShaderProgram>
+        weighted_blended_composite_multisampled_shader_program;
+    const std::shared_ptr<GlShaderProgram> a_buffer_resolve_shader_program;
+    // The programs of the visuals, and their variants which store
+    // the fragments into the A-buffer.
     const std::shared_ptr<GlShaderProgram> circle_shader_program;
+    const std::shared_ptr<GlShaderProgram> circle_a_buffer_shader_program;
     const std::shared_ptr<GlShaderProgram> linesegments_shader_program;
+    const std::shared_ptr<GlShaderProgram>
+        linesegments_a_buffer_shader_program;
     const std::shared_ptr<GlShaderProgram> lines_shader_program;
+    const std::shared_ptr<GlShaderProgram> lines_a_buffer_shader_program;
     const std::shared_ptr<GlShaderProgram> surface_shader_program;
+    const std::shared_ptr<GlShaderProgram> surface_a_buffer_shader_program;
+    const std::shared_ptr<GlShaderProgram> yuv420p_shader_program;
 };
 }
 
@@ -6,7 +6,8 @@ Expected<std::shared_ptr<GlTexture>, Error> GlTexture::create(
     std::shared_ptr<WrappedGlfwWindow> glfw_window,
     const glm::uvec2 &size,
     const bool depth,
-    const std::optional<int> samples
+    const std::optional<int> samples,
+    const std::optional<GLint> internalformat_in
 )
 {
     if (!glfw_window)
@@ -25,8 +26,10 @@ Expected<std::shared_ptr<GlTexture>, Error> GlTexture::create(
     glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    const GLint internalformat = GlTexture::internalformat(depth);
-    const GLenum format = GlTexture::format(depth);
+    const GLint internalformat = internalformat_in
+                                     ? internalformat_in.value()
+                                     : GlTexture::default_internalformat(depth);
+    const GLenum format = GlTexture::format(depth, internalformat);
 
     if (samples)
         glTexImage2DMultisample(
@@ -45,9 +48,9 @@ Expected<std::shared_ptr<GlTexture>, Error> GlTexture::create(
             nullptr
         );
 
-    return std::shared_ptr<GlTexture>(
-        new GlTexture(glfw_window, index, size, depth, samples)
-    );
+    return std::shared_ptr<GlTexture>(new GlTexture(
+        glfw_window, index, size, depth, samples, internalformat
+    ));
 }
 
 void GlTexture::bind(bool make_context) const
@@ -57,17 +60,43 @@ void GlTexture::bind(bool make_context) const
     glBindTexture(this->target(), this->index);
 }
 
-void GlTexture::framebuffer_texture(bool make_context) const
+void GlTexture::framebuffer_texture(
+    bool make_context, const unsigned int color_attachment
+) const
 {
     if (make_context)
         this->glfw_window->make_current_context();
-    const GLenum attachment =
-        this->depth ? GL_DEPTH_ATTACHMENT : GL_COLOR_ATTACHMENT0;
+    const GLenum attachment = this->depth
+                                  ? GL_DEPTH_ATTACHMENT
+                                  : GL_COLOR_ATTACHMENT0 + color_attachment;
     glFramebufferTexture2D(
         GL_FRAMEBUFFER, attachment, this->target(), this->index, 0
     );
 }
 
+void GlTexture::copy_image(const GlTexture &source, bool make_context) const
+{
+    if (make_context)
+        this->glfw_window->make_current_context();
+    glCopyImageSubData(
+        source.index,
+        source.target(),
+        0,
+        0,
+        0,
+        0,
+        this->index,
+        this->target(),
+        0,
+        0,
+        0,
+        0,
+        this->size.x,
+        this->size.y,
+        1
+    );
+}
+
 glm::uvec2 GlTexture::get_size() const
 {
     return this->size;
@@ -80,7 +109,7 @@ void GlTexture::set_size(const glm::uvec2 &size)
         glTexImage2DMultisample(
             this->target(),
             samples.value(),
-            this->internalformat(),
+            this->internalformat,
             size.x,
             size.y,
             GL_TRUE
@@ -89,7 +118,7 @@ void GlTexture::set_size(const glm::uvec2 &size)
         glTexImage2D(
             this->target(),
             0,
-            this->internalformat(),
+            this->internalformat,
             size.x,
             size.y,
             0,
@@ -111,12 +140,14 @@ GlTexture::GlTexture(
     const GLuint index,
     const glm::uvec2 &size,
     bool depth,
-    const std::optional<int> samples
+    const std::optional<int> samples,
+    const GLint internalformat
 )
     : glfw_window(glfw_window),
       index(index),
       size(size),
       depth(depth),
+      internalformat(internalformat),
       samples(samples)
 {}
 
@@ -130,24 +161,57 @@ GLenum GlTexture::target() const
     return GlTexture::target(this->samples);
 }
 
-GLint GlTexture::internalformat(bool depth)
+GLint GlTexture::get_internalformat() const
 {
-    return depth ? GL_DEPTH_COMPONENT32F : GL_RGBA32F;
+    return this->internalformat;
+}
+
+void GlTexture::set_render_fence(std::shared_ptr<const GlFence> render_fence)
+{
+    this->render_fence = render_fence;
+}
+
+Expected<void, Error> GlTexture::client_wait_rendered(bool make_context
+) const
+{
+    if (!this->render_fence)
+        return Expected<void, Error>();
+    return this->render_fence->client_wait(make_context);
 }
 
-GLint GlTexture::internalformat() const
+void GlTexture::server_wait_rendered() const
 {
-    return GlTexture::internalformat(this->depth);
+    if (this->render_fence)
+        this->render_fence->server_wait();
 }
 
-GLenum GlTexture::format(bool depth)
+GLint GlTexture::default_internalformat(bool depth)
 {
-    return depth ? GL_DEPTH_COMPONENT : GL_RGBA;
+    return depth ? GL_DEPTH_COMPONENT32F : GL_RGBA32F;
+}
+
+GLenum GlTexture::format(bool depth, GLint internalformat)
+{
+    if (depth)
+        return GL_DEPTH_COMPONENT;
+
+    switch (internalformat)
+    {
+    case GL_R8:
+    case GL_R16F:
+    case GL_R32F:
+        return GL_RED;
+    case GL_RG16F:
+    case GL_RG32F:
+        return GL_RG;
+    default:
+        return GL_RGBA;
+    }
 }
 
 GLenum GlTexture::format() const
 {
-    return GlTexture::format(this->depth);
+    return GlTexture::format(this->depth, this->internalformat);
 }
 
 Expected<std::shared_ptr<GlFramebuffer>, Error>
@@ -201,7 +265,8 @@ Expected<std::shared_ptr<GlFramebufferTexture>, Error>
     GlFramebufferTexture::create(
         std::shared_ptr<WrappedGlfwWindow> glfw_window,
         const glm::uvec2 &size,
-        const std::optional<int> samples
+        const std::optional<int> samples,
+        const std::optional<GLint> internalformat
     )
 {
     if (!glfw_window)
@@ -218,7 +283,7 @@ Expected<std::shared_ptr<GlFramebufferTexture>, Error>
     glDrawBuffers(1, DrawBuffers);
 
     Expected<std::shared_ptr<GlTexture>, Error> texture =
-        GlTexture::create(glfw_window, size, false, samples);
+        GlTexture::create(glfw_window, size, false, samples, internalformat);
     if (!texture)
         return Unexpected<Error>(Error());
     texture.value()->bind();
@@ -811,6 +876,17 @@ void GlShaderBuffer::bind_buffer_base(GLuint binding, bool make_context) const
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->index);
 }
 
+void GlShaderBuffer::copy_sub_data(
+    const GlShaderBuffer &source, const size_t size, bool make_context
+) const
+{
+    if (make_context)
+        this->glfw_window->make_current_context();
+    glBindBuffer(GL_COPY_READ_BUFFER, source.index);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->index);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+}
+
 GlShaderBuffer::~GlShaderBuffer()
 {
     this->glfw_window->make_current_context();
@@ -823,6 +899,212 @@ GlShaderBuffer::GlShaderBuffer(
     : glfw_window(glfw_window), index(index)
 {}
 
+Expected<std::shared_ptr<GlPixelBuffer>, Error> GlPixelBuffer::create(
+    std::shared_ptr<WrappedGlfwWindow> glfw_window, const size_t size
+)
+{
+    if (!glfw_window)
+        return Unexpected<Error>(Error());
+    glfw_window->make_current_context();
+
+    GLuint index;
+    glGenBuffers(1, &index);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, index);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return std::shared_ptr<GlPixelBuffer>(
+        new GlPixelBuffer(glfw_window, index, size)
+    );
+}
+
+void GlPixelBuffer::bind(bool make_context) const
+{
+    if (make_context)
+        this->glfw_window->make_current_context();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, this->index);
+}
+
+void GlPixelBuffer::pack_texture(
+    const GlTexture &texture,
+    const GLenum format,
+    const GLenum type,
+    const size_t offset,
+    bool make_context
+) const
+{
+    this->bind(make_context);
+    texture.bind(false);
+    // Rows of planar formats are not necessarily 4-byte aligned.
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // While a pixel pack buffer is bound, the last argument is interpreted
+    // as an offset into the buffer, and the call does not wait for the
+    // rendering to finish.
+    glGetTexImage(
+        GL_TEXTURE_2D, 0, format, type, reinterpret_cast<void *>(offset)
+    );
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // Unbind, otherwise every later read into client memory
+    // would be redirected into this buffer.
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+Expected<const void *, Error> GlPixelBuffer::map(bool make_context) const
+{
+    this->bind(make_context);
+    const void *data =
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, this->size, GL_MAP_READ_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!data)
+        return Unexpected<Error>(Error());
+    return data;
+}
+
+void GlPixelBuffer::unmap(bool make_context) const
+{
+    this->bind(make_context);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+size_t GlPixelBuffer::get_size() const
+{
+    return this->size;
+}
+
+GlPixelBuffer::~GlPixelBuffer()
+{
+    this->glfw_window->make_current_context();
+    glDeleteBuffers(1, &this->index);
+}
+
+GlPixelBuffer::GlPixelBuffer(
+    std::shared_ptr<WrappedGlfwWindow> glfw_window,
+    const GLuint index,
+    const size_t size
+)
+    : glfw_window(glfw_window), index(index), size(size)
+{}
+
+Expected<std::shared_ptr<GlFence>, Error>
+    GlFence::create(std::shared_ptr<WrappedGlfwWindow> glfw_window)
+{
+    if (!glfw_window)
+        return Unexpected<Error>(Error());
+    glfw_window->make_current_context();
+
+    const GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (!sync)
+        return Unexpected<Error>(Error());
+
+    // Make sure the fence (and everything before it) is submitted,
+    // otherwise it might never be signaled if it is waited for
+    // from an other context.
+    glFlush();
+
+    return std::shared_ptr<GlFence>(new GlFence(glfw_window, sync));
+}
+
+bool GlFence::is_signaled(bool make_context) const
+{
+    if (make_context)
+        this->glfw_window->make_current_context();
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv(this->sync, GL_SYNC_STATUS, 1, nullptr, &status);
+    return status == GL_SIGNALED;
+}
+
+Expected<void, Error> GlFence::client_wait(bool make_context) const
+{
+    if (make_context)
+        this->glfw_window->make_current_context();
+
+    // Wait in slices of one second,
+    // so that a very long frame does not count as a failure.
+    const GLuint64 timeout = 1000000000;
+    while (true)
+    {
+        const GLenum result =
+            glClientWaitSync(this->sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+            return Expected<void, Error>();
+        if (result == GL_WAIT_FAILED)
+            return Unexpected<Error>(Error());
+    }
+}
+
+void GlFence::server_wait() const
+{
+    glWaitSync(this->sync, 0, GL_TIMEOUT_IGNORED);
+}
+
+GlFence::~GlFence()
+{
+    this->glfw_window->make_current_context();
+    glDeleteSync(this->sync);
+}
+
+GlFence::GlFence(
+    std::shared_ptr<WrappedGlfwWindow> glfw_window, const GLsync sync
+)
+    : glfw_window(glfw_window), sync(sync)
+{}
+
+Expected<std::shared_ptr<GlQuery>, Error> GlQuery::create(
+    std::shared_ptr<WrappedGlfwWindow> glfw_window, const GLenum target
+)
+{
+    if (!glfw_window)
+        return Unexpected<Error>(Error());
+    glfw_window->make_current_context();
+
+    GLuint index;
+    glGenQueries(1, &index);
+    return std::shared_ptr<GlQuery>(new GlQuery(glfw_window, index, target));
+}
+
+void GlQuery::begin(bool make_context) const
+{
+    if (make_context)
+        this->glfw_window->make_current_context();
+    glBeginQuery(this->target, this->index);
+}
+
+void GlQuery::end(bool make_context) const
+{
+    if (make_context)
+        this->glfw_window->make_current_context();
+    glEndQuery(this->target);
+}
+
+void GlQuery::begin_conditional_render(bool make_context) const
+{
+    if (make_context)
+        this->glfw_window->make_current_context();
+    glBeginConditionalRender(this->index, GL_QUERY_WAIT);
+}
+
+void GlQuery::end_conditional_render(bool make_context) const
+{
+    if (make_context)
+        this->glfw_window->make_current_context();
+    glEndConditionalRender();
+}
+
+GlQuery::~GlQuery()
+{
+    this->glfw_window->make_current_context();
+    glDeleteQueries(1, &this->index);
+}
+
+GlQuery::GlQuery(
+    std::shared_ptr<WrappedGlfwWindow> glfw_window,
+    const GLuint index,
+    const GLenum target
+)
+    : glfw_window(glfw_window), index(index), target(target)
+{}
+
 Expected<std::shared_ptr<GlSurface>, Error> GlSurface::create(
     std::shared_ptr<WrappedGlfwWindow> glfw_window,
     const SurfaceData &surface_data
@@ -10,6 +10,8 @@
 
 namespace elementary_visualizer
 {
+class GlFence;
+
 class GlTexture
 {
 public:
@@ -18,14 +20,36 @@ public:
         std::shared_ptr<WrappedGlfwWindow> glfw_window,
         const glm::uvec2 &size,
         bool depth,
-        const std::optional<int> samples
+        const std::optional<int> samples,
+        const std::optional<GLint> internalformat = std::nullopt
     );
 
     void bind(bool make_context = true) const;
-    void framebuffer_texture(bool make_context = true) const;
+    // Attaches the texture to the bound framebuffer, a color texture
+    // to the color attachment of the index.
+    void framebuffer_texture(
+        bool make_context = true, const unsigned int color_attachment = 0
+    ) const;
+
+    // Copies the image of a texture of the same size, format
+    // and samples into this one.
+    void copy_image(const GlTexture &source, bool make_context = true) const;
 
     glm::uvec2 get_size() const;
     void set_size(const glm::uvec2 &size);
+    GLint get_internalformat() const;
+
+    // The fence after the commands which last rendered into the texture,
+    // without it the texture counts as rendered.
+    void set_render_fence(std::shared_ptr<const GlFence> render_fence);
+    // Blocks until the commands which last rendered into the texture
+    // have completed.
+    Expected<void, Error> client_wait_rendered(bool make_context = true
+    ) const;
+    // Makes the commands issued after this in the current context wait
+    // for the commands which last rendered into the texture, without
+    // blocking.
+    void server_wait_rendered() const;
 
     ~GlTexture();
 
@@ -41,20 +65,22 @@ private:
         const GLuint index,
         const glm::uvec2 &size,
         const bool depth,
-        const std::optional<int> samples
+        const std::optional<int> samples,
+        const GLint internalformat
     );
 
     static GLenum target(const std::optional<int> &samples);
     GLenum target() const;
-    static GLint internalformat(bool depth);
-    GLint internalformat() const;
-    static GLenum format(bool depth);
+    static GLint default_internalformat(bool depth);
+    static GLenum format(bool depth, GLint internalformat);
     GLenum format() const;
 
     std::shared_ptr<WrappedGlfwWindow> glfw_window;
     const GLuint index;
     glm::uvec2 size;
     const bool depth;
+    const GLint internalformat;
+    std::shared_ptr<const GlFence> render_fence;
 
 public:
 
@@ -105,7 +131,8 @@ public:
     static Expected<std::shared_ptr<GlFramebufferTexture>, Error> create(
         std::shared_ptr<WrappedGlfwWindow> glfw_window,
         const glm::uvec2 &size,
-        const std::optional<int> samples
+        const std::optional<int> samples,
+        const std::optional<GLint> internalformat = std::nullopt
     );
 
     const std::shared_ptr<GlFramebuffer> framebuffer;
@@ -320,6 +347,14 @@ public:
     void bind(bool make_context = true) const;
     void bind_buffer_base(GLuint binding, bool make_context = true) const;
 
+    // Queues the copy of the first bytes of the source buffer
+    // into the start of this one.
+    void copy_sub_data(
+        const GlShaderBuffer &source,
+        const size_t size,
+        bool make_context = true
+    ) const;
+
     ~GlShaderBuffer();
 
     GlShaderBuffer(GlShaderBuffer &&other) = delete;
@@ -337,6 +372,125 @@ private:
     const GLuint index;
 };
 
+class GlPixelBuffer
+{
+public:
+
+    static Expected<std::shared_ptr<GlPixelBuffer>, Error> create(
+        std::shared_ptr<WrappedGlfwWindow> glfw_window, const size_t size
+    );
+
+    void bind(bool make_context = true) const;
+
+    // Queues the copy of the texture's image into this buffer
+    // at the given byte offset. The copy is asynchronous,
+    // the data is available after the copy has completed,
+    // which can be waited for with a `GlFence`.
+    void pack_texture(
+        const GlTexture &texture,
+        const GLenum format,
+        const GLenum type,
+        const size_t offset = 0,
+        bool make_context = true
+    ) const;
+
+    // Maps the buffer for reading. The returned pointer is valid
+    // until `unmap` is called.
+    Expected<const void *, Error> map(bool make_context = true) const;
+    void unmap(bool make_context = true) const;
+
+    size_t get_size() const;
+
+    ~GlPixelBuffer();
+
+    GlPixelBuffer(GlPixelBuffer &&other) = delete;
+    GlPixelBuffer &operator=(GlPixelBuffer &&other) = delete;
+    GlPixelBuffer(const GlPixelBuffer &other) = delete;
+    GlPixelBuffer &operator=(const GlPixelBuffer &other) = delete;
+
+private:
+
+    GlPixelBuffer(
+        std::shared_ptr<WrappedGlfwWindow> glfw_window,
+        const GLuint index,
+        const size_t size
+    );
+
+    std::shared_ptr<WrappedGlfwWindow> glfw_window;
+    const GLuint index;
+    const size_t size;
+};
+
+class GlFence
+{
+public:
+
+    // Inserts a fence into the command queue of the current context.
+    static Expected<std::shared_ptr<GlFence>, Error>
+        create(std::shared_ptr<WrappedGlfwWindow> glfw_window);
+
+    bool is_signaled(bool make_context = true) const;
+
+    // Blocks until every command before the fence has completed.
+    Expected<void, Error> client_wait(bool make_context = true) const;
+
+    // Makes the commands issued after this in the current context wait
+    // for every command before the fence, without blocking.
+    void server_wait() const;
+
+    ~GlFence();
+
+    GlFence(GlFence &&other) = delete;
+    GlFence &operator=(GlFence &&other) = delete;
+    GlFence(const GlFence &other) = delete;
+    GlFence &operator=(const GlFence &other) = delete;
+
+private:
+
+    GlFence(std::shared_ptr<WrappedGlfwWindow> glfw_window, const GLsync sync);
+
+    std::shared_ptr<WrappedGlfwWindow> glfw_window;
+    const GLsync sync;
+};
+
+class GlQuery
+{
+public:
+
+    static Expected<std::shared_ptr<GlQuery>, Error> create(
+        std::shared_ptr<WrappedGlfwWindow> glfw_window, const GLenum target
+    );
+
+    // The commands between these are counted by the query.
+    void begin(bool make_context = true) const;
+    void end(bool make_context = true) const;
+
+    // The draws and clears between these are only done by the GPU
+    // if the query (of samples passed) has counted any sample.
+    // The GPU waits for the result, without blocking the CPU.
+    void begin_conditional_render(bool make_context = true) const;
+    void end_conditional_render(bool make_context = true) const;
+
+    ~GlQuery();
+
+    GlQuery(GlQuery &&other) = delete;
+    GlQuery &operator=(GlQuery &&other) = delete;
+    GlQuery(const GlQuery &other) = delete;
+    GlQuery &operator=(const GlQuery &other) = delete;
+
+private:
+
+    GlQuery(
+        std::shared_ptr<WrappedGlfwWindow> glfw_window,
+        const GLuint index,
+        const GLenum target
+    );
+
+    std::shared_ptr<WrappedGlfwWindow> glfw_window;
+    const GLuint index;
+    const GLenum target;
+};
+
 class GlSurface
 {
 public:
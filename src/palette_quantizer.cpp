@@ -0,0 +1,481 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <palette_quantizer.hpp>
+
+#if defined(__SSE2__)
+#define ELEMENTARY_VISUALIZER_PALETTE_QUANTIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace elementary_visualizer
+{
+// Below this many pixels for each thread, starting the threads
+// costs more than what they save.
+static const size_t palette_quantizer_pixels_per_thread = 65536;
+
+RowWorkers::RowWorkers(const unsigned int thread_count)
+    : thread_count(std::max(thread_count, 1u)),
+      function(nullptr),
+      height(0),
+      range_count(0),
+      generation(0),
+      ranges_left(0),
+      stopping(false)
+{
+    for (unsigned int range = 0; range + 1 < this->thread_count; ++range)
+        this->threads.emplace_back(&RowWorkers::run, this, range);
+}
+
+void RowWorkers::for_rows(
+    const unsigned int width,
+    const unsigned int height,
+    const RowFunction &function
+)
+{
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+    const size_t range_count = std::clamp<size_t>(
+        pixel_count / palette_quantizer_pixels_per_thread,
+        1,
+        std::min<size_t>(this->thread_count, height)
+    );
+
+    if (range_count > 1)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->function = &function;
+            this->height = height;
+            this->range_count = range_count;
+            this->ranges_left = range_count - 1;
+            ++this->generation;
+        }
+        this->work_queued.notify_all();
+    }
+
+    function(
+        range_count - 1, height * (range_count - 1) / range_count, height
+    );
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->work_done.wait(lock, [this] { return this->ranges_left == 0; });
+}
+
+RowWorkers::~RowWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->work_queued.notify_all();
+    for (std::thread &thread : this->threads)
+        thread.join();
+}
+
+void RowWorkers::run(const size_t range)
+{
+    uint64_t generation = 0;
+    while (true)
+    {
+        const RowFunction *function;
+        size_t begin;
+        size_t end;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->work_queued.wait(
+                lock,
+                [&] {
+                    return this->stopping || this->generation != generation;
+                }
+            );
+            if (this->stopping)
+                return;
+            generation = this->generation;
+            // Small images are split into fewer ranges than threads.
+            if (range + 1 >= this->range_count)
+                continue;
+            function = this->function;
+            begin = this->height * range / this->range_count;
+            end = this->height * (range + 1) / this->range_count;
+        }
+
+        (*function)(range, begin, end);
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            --this->ranges_left;
+        }
+        this->work_done.notify_one();
+    }
+}
+
+static uint16_t rgb_to_15_bit(const uint8_t r, const uint8_t g, const uint8_t b)
+{
+    return static_cast<uint16_t>(((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3));
+}
+
+// Component of a 15-bit color, 0 is red, 1 is green and 2 is blue.
+static unsigned int component_5_bit(const uint16_t color, const int axis)
+{
+    return (color >> (10 - 5 * axis)) & 31;
+}
+
+// Expands a 5-bit component, so that 0 and 31 become 0 and 255.
+static unsigned int component_8_bit(const uint16_t color, const int axis)
+{
+    const unsigned int component = component_5_bit(color, axis);
+    return (component << 3) | (component >> 2);
+}
+
+void rgba8_row_to_15_bit(
+    const uint8_t *source, const size_t width, uint16_t *destination
+)
+{
+    size_t x = 0;
+#ifdef ELEMENTARY_VISUALIZER_PALETTE_QUANTIZER_SSE2
+    // Processes 8 pixels at once, the red of each pixel
+    // is in its lowest byte.
+    const __m128i red_mask = _mm_set1_epi32(0x000000f8);
+    const __m128i green_mask = _mm_set1_epi32(0x0000f800);
+    const __m128i blue_mask = _mm_set1_epi32(0x00f80000);
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i colors[2];
+        for (int i = 0; i < 2; ++i)
+        {
+            const __m128i pixels = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(source + 4 * x + 16 * i)
+            );
+            const __m128i red =
+                _mm_slli_epi32(_mm_and_si128(pixels, red_mask), 7);
+            const __m128i green =
+                _mm_srli_epi32(_mm_and_si128(pixels, green_mask), 6);
+            const __m128i blue =
+                _mm_srli_epi32(_mm_and_si128(pixels, blue_mask), 19);
+            colors[i] = _mm_or_si128(_mm_or_si128(red, green), blue);
+        }
+        // The colors fit into 15 bits, so the signed saturation
+        // does not change them.
+        _mm_storeu_si128(
+            reinterpret_cast<__m128i *>(destination + x),
+            _mm_packs_epi32(colors[0], colors[1])
+        );
+    }
+#endif
+    for (; x < width; ++x)
+        destination[x] = rgb_to_15_bit(
+            source[4 * x + 0], source[4 * x + 1], source[4 * x + 2]
+        );
+}
+
+Expected<std::shared_ptr<PaletteQuantizer>, Error> PaletteQuantizer::create(
+    const unsigned int width,
+    const unsigned int height,
+    const unsigned int segment_size,
+    const unsigned int sample_size,
+    const unsigned int thread_count
+)
+{
+    if (width == 0 || height == 0 || thread_count == 0)
+        return Unexpected<Error>(Error());
+
+    return std::shared_ptr<PaletteQuantizer>(new PaletteQuantizer(
+        width, height, segment_size, std::max(sample_size, 1u), thread_count
+    ));
+}
+
+Expected<void, Error> PaletteQuantizer::add_frame(const AVFrame *frame)
+{
+    if (!frame)
+        return Unexpected<Error>(Error());
+    if (frame->width != static_cast<int>(this->width) ||
+        frame->height != static_cast<int>(this->height))
+        return Unexpected<Error>(Error());
+    const bool rgba = frame->format == AV_PIX_FMT_RGBA;
+    if (!rgba && frame->format != AV_PIX_FMT_RGB24)
+        return Unexpected<Error>(Error());
+
+    // A complete segment is followed by a new one with a new palette.
+    if (this->segment_size > 0 &&
+        this->segment_frame_count >= this->segment_size)
+    {
+        this->segment_frame_count = 0;
+        this->palette_generated = false;
+        for (std::vector<uint64_t> &histogram : this->histograms)
+            std::fill(histogram.begin(), histogram.end(), 0);
+    }
+
+    if (this->frame_count == this->frames.size())
+    {
+        this->frames.emplace_back(
+            static_cast<size_t>(this->width) * this->height
+        );
+        this->timestamps.push_back(AV_NOPTS_VALUE);
+    }
+    uint16_t *colors = this->frames[this->frame_count].data();
+    this->timestamps[this->frame_count] = frame->pts;
+    ++this->frame_count;
+    ++this->segment_frame_count;
+
+    // Once the palette is generated, the colors are not counted.
+    const bool count_colors = !this->palette_generated;
+    this->workers.for_rows(
+        this->width,
+        this->height,
+        [&](const size_t range, const size_t begin, const size_t end)
+        {
+            std::vector<uint64_t> &histogram = this->histograms[range];
+            for (size_t y = begin; y < end; ++y)
+            {
+                const uint8_t *source = frame->data[0] + y * frame->linesize[0];
+                uint16_t *row = colors + y * this->width;
+                if (rgba)
+                {
+                    rgba8_row_to_15_bit(source, this->width, row);
+                }
+                else
+                {
+                    for (size_t x = 0; x < this->width; ++x)
+                        row[x] = rgb_to_15_bit(
+                            source[3 * x + 0],
+                            source[3 * x + 1],
+                            source[3 * x + 2]
+                        );
+                }
+                if (count_colors)
+                    for (size_t x = 0; x < this->width; ++x)
+                        ++histogram[row[x]];
+            }
+        }
+    );
+
+    return Expected<void, Error>();
+}
+
+size_t PaletteQuantizer::get_frame_count() const
+{
+    return this->frame_count;
+}
+
+bool PaletteQuantizer::is_sample_complete() const
+{
+    // A segment which is shorter than the sample is complete
+    // at its end.
+    return !this->palette_generated &&
+           (this->frame_count >= this->sample_size ||
+            (this->segment_size > 0 &&
+             this->segment_frame_count >= this->segment_size));
+}
+
+bool PaletteQuantizer::has_palette() const
+{
+    return this->palette_generated;
+}
+
+void PaletteQuantizer::generate_palette()
+{
+    struct Color
+    {
+        uint16_t color;
+        uint64_t count;
+    };
+    std::vector<Color> colors;
+    for (size_t color = 0; color < palette_quantizer_color_count; ++color)
+    {
+        uint64_t count = 0;
+        for (const std::vector<uint64_t> &histogram : this->histograms)
+            count += histogram[color];
+        if (count > 0)
+            colors.push_back({static_cast<uint16_t>(color), count});
+    }
+
+    // A box is a range of the colors, with the axis along which
+    // its colors spread the most.
+    struct Box
+    {
+        size_t begin;
+        size_t end;
+        int axis;
+        unsigned int spread;
+    };
+    auto create_box = [&](const size_t begin, const size_t end)
+    {
+        Box box = {begin, end, 0, 0};
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            unsigned int minimum = 31;
+            unsigned int maximum = 0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                const unsigned int component =
+                    component_5_bit(colors[i].color, axis);
+                minimum = std::min(minimum, component);
+                maximum = std::max(maximum, component);
+            }
+            if (maximum - minimum > box.spread || axis == 0)
+            {
+                box.axis = axis;
+                box.spread = maximum - minimum;
+            }
+        }
+        return box;
+    };
+
+    // Median cut: the box which spreads the most is split
+    // at the median pixel along its axis, until there are
+    // enough boxes, or every box has a single color.
+    std::vector<Box> boxes;
+    if (!colors.empty())
+        boxes.push_back(create_box(0, colors.size()));
+    while (boxes.size() < this->palette.size())
+    {
+        auto box = std::max_element(
+            boxes.begin(),
+            boxes.end(),
+            [](const Box &a, const Box &b) { return a.spread < b.spread; }
+        );
+        if (box->spread == 0)
+            break;
+
+        const int axis = box->axis;
+        std::sort(
+            colors.begin() + box->begin,
+            colors.begin() + box->end,
+            [axis](const Color &a, const Color &b)
+            {
+                return component_5_bit(a.color, axis) <
+                       component_5_bit(b.color, axis);
+            }
+        );
+
+        uint64_t total = 0;
+        for (size_t i = box->begin; i < box->end; ++i)
+            total += colors[i].count;
+        size_t split = box->begin + 1;
+        uint64_t count = colors[box->begin].count;
+        while (split + 1 < box->end && 2 * count < total)
+            count += colors[split++].count;
+
+        const size_t begin = box->begin;
+        const size_t end = box->end;
+        *box = create_box(begin, split);
+        boxes.push_back(create_box(split, end));
+    }
+
+    // Each palette color is the average of the pixels in its box.
+    this->palette.fill(0xff000000);
+    for (size_t index = 0; index < boxes.size(); ++index)
+    {
+        uint64_t sums[3] = {0, 0, 0};
+        uint64_t total = 0;
+        for (size_t i = boxes[index].begin; i < boxes[index].end; ++i)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+                sums[axis] +=
+                    colors[i].count * component_8_bit(colors[i].color, axis);
+            total += colors[i].count;
+        }
+        uint32_t argb = 0xff000000;
+        for (int axis = 0; axis < 3; ++axis)
+            argb |= static_cast<uint32_t>((sums[axis] + total / 2) / total)
+                    << (16 - 8 * axis);
+        this->palette[index] = argb;
+    }
+
+    // Each 15-bit color is mapped to the nearest palette color.
+    const size_t palette_size = std::max<size_t>(boxes.size(), 1);
+    const unsigned int lookup_width = 1024;
+    this->workers.for_rows(
+        lookup_width,
+        palette_quantizer_color_count / lookup_width,
+        [&](const size_t, const size_t begin, const size_t end)
+        {
+            for (size_t color = begin * lookup_width;
+                 color < end * lookup_width;
+                 ++color)
+            {
+                int nearest_distance = std::numeric_limits<int>::max();
+                for (size_t index = 0; index < palette_size; ++index)
+                {
+                    int distance = 0;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        const int difference =
+                            static_cast<int>(component_8_bit(
+                                static_cast<uint16_t>(color), axis
+                            )) -
+                            static_cast<int>(
+                                (this->palette[index] >> (16 - 8 * axis)) &
+                                0xff
+                            );
+                        distance += difference * difference;
+                    }
+                    if (distance < nearest_distance)
+                    {
+                        nearest_distance = distance;
+                        this->lookup_table[color] =
+                            static_cast<uint8_t>(index);
+                    }
+                }
+            }
+        }
+    );
+
+    this->palette_generated = true;
+}
+
+void PaletteQuantizer::quantize_frame(const size_t index, AVFrame *frame)
+{
+    std::memcpy(frame->data[1], this->palette.data(), 4 * this->palette.size());
+
+    const uint16_t *colors = this->frames[index].data();
+    this->workers.for_rows(
+        this->width,
+        this->height,
+        [&](const size_t, const size_t begin, const size_t end)
+        {
+            for (size_t y = begin; y < end; ++y)
+            {
+                const uint16_t *row = colors + y * this->width;
+                uint8_t *destination = frame->data[0] + y * frame->linesize[0];
+                for (size_t x = 0; x < this->width; ++x)
+                    destination[x] = this->lookup_table[row[x]];
+            }
+        }
+    );
+}
+
+int64_t PaletteQuantizer::get_frame_timestamp(const size_t index) const
+{
+    return this->timestamps[index];
+}
+
+void PaletteQuantizer::clear()
+{
+    this->frame_count = 0;
+}
+
+PaletteQuantizer::PaletteQuantizer(
+    const unsigned int width,
+    const unsigned int height,
+    const unsigned int segment_size,
+    const unsigned int sample_size,
+    const unsigned int thread_count
+)
+    : width(width),
+      height(height),
+      segment_size(segment_size),
+      sample_size(sample_size),
+      workers(thread_count),
+      frames(),
+      timestamps(),
+      frame_count(0),
+      segment_frame_count(0),
+      palette_generated(false),
+      histograms(
+          thread_count, std::vector<uint64_t>(palette_quantizer_color_count, 0)
+      ),
+      palette(),
+      lookup_table(palette_quantizer_color_count, 0)
+{}
+}
@@ -0,0 +1,162 @@
+#ifndef ELEMENTARY_VISUALIZER_PALETTE_QUANTIZER_HPP
+#define ELEMENTARY_VISUALIZER_PALETTE_QUANTIZER_HPP
+
+#include <array>
+#include <av_resources.hpp>
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <elementary_visualizer/elementary_visualizer.hpp>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace elementary_visualizer
+{
+// Number of colors with 5 bits per component.
+inline constexpr size_t palette_quantizer_color_count = 32768;
+
+// Converts a row of RGBA8 pixels into 15-bit colors, with 5 bits
+// per component: red in the highest bits, blue in the lowest ones.
+void rgba8_row_to_15_bit(
+    const uint8_t *source, const size_t width, uint16_t *destination
+);
+
+// Threads which are kept for the whole video, and which split
+// the rows of an image between them, so that no thread is started
+// for each frame.
+class RowWorkers
+{
+public:
+
+    // Function which is called with the index of the range,
+    // and the first and the last (exclusive) row of the range.
+    using RowFunction =
+        std::function<void(size_t range, size_t begin, size_t end)>;
+
+    // The calling thread counts as one of the threads.
+    explicit RowWorkers(const unsigned int thread_count);
+
+    // Splits the rows into contiguous ranges, and calls the function
+    // on each range on its own thread; the last range is done
+    // on the calling thread. Returns once every range is done.
+    void for_rows(
+        const unsigned int width,
+        const unsigned int height,
+        const RowFunction &function
+    );
+
+    ~RowWorkers();
+
+    RowWorkers(RowWorkers &&other) = delete;
+    RowWorkers &operator=(RowWorkers &&other) = delete;
+    RowWorkers(const RowWorkers &) = delete;
+    RowWorkers &operator=(const RowWorkers &) = delete;
+
+private:
+
+    void run(const size_t range);
+
+    const unsigned int thread_count;
+
+    std::mutex mutex;
+    // Notified when a new image is split, or the workers are stopping.
+    std::condition_variable work_queued;
+    // Notified when a worker is done with its range.
+    std::condition_variable work_done;
+    const RowFunction *function;
+    unsigned int height;
+    size_t range_count;
+    // Incremented for each image, so that each worker runs once.
+    uint64_t generation;
+    size_t ranges_left;
+    bool stopping;
+
+    std::vector<std::thread> threads;
+};
+
+// Quantizes RGB frames directly into PAL8 frames (e.g. for GIF).
+// The first frames of a segment are buffered as 15-bit colors,
+// and a palette is generated from them by median cut. The palette
+// is then cached for the rest of the segment, so the later frames
+// are quantized as they arrive, through a lookup table of the 15-bit
+// colors. The conversions are split between threads.
+class PaletteQuantizer
+{
+public:
+
+    // With a segment size of 0, the whole video is one segment,
+    // so every frame shares the same palette. A sample size of 0
+    // counts as 1.
+    static Expected<std::shared_ptr<PaletteQuantizer>, Error> create(
+        const unsigned int width,
+        const unsigned int height,
+        const unsigned int segment_size,
+        const unsigned int sample_size,
+        const unsigned int thread_count
+    );
+
+    // Buffers an RGBA or RGB24 frame, with its pts as the timestamp.
+    // The first frame of a segment drops the palette of the previous
+    // one, and the frames count towards the palette until it is
+    // generated.
+    Expected<void, Error> add_frame(const AVFrame *frame);
+    size_t get_frame_count() const;
+    // Whether enough frames of the segment are buffered
+    // to generate its palette.
+    bool is_sample_complete() const;
+    // Whether the palette of the current segment is generated.
+    bool has_palette() const;
+
+    // Generates the palette of the frames added in the segment so far.
+    void generate_palette();
+    // Quantizes a buffered frame into a PAL8 frame with the palette.
+    void quantize_frame(const size_t index, AVFrame *frame);
+    int64_t get_frame_timestamp(const size_t index) const;
+    // Drops the buffered frames, but keeps their memory and the palette.
+    void clear();
+
+    PaletteQuantizer(PaletteQuantizer &&other) = delete;
+    PaletteQuantizer &operator=(PaletteQuantizer &&other) = delete;
+    PaletteQuantizer(const PaletteQuantizer &) = delete;
+    PaletteQuantizer &operator=(const PaletteQuantizer &) = delete;
+
+private:
+
+    PaletteQuantizer(
+        const unsigned int width,
+        const unsigned int height,
+        const unsigned int segment_size,
+        const unsigned int sample_size,
+        const unsigned int thread_count
+    );
+
+    const unsigned int width;
+    const unsigned int height;
+    const unsigned int segment_size;
+    const unsigned int sample_size;
+
+    RowWorkers workers;
+
+    // The buffered frames are the first `frame_count` ones.
+    std::vector<std::vector<uint16_t>> frames;
+    std::vector<int64_t> timestamps;
+    size_t frame_count;
+    // Number of frames added in the current segment.
+    size_t segment_frame_count;
+    bool palette_generated;
+    // Number of pixels of each 15-bit color in the frames of the segment
+    // before its palette, counted by each thread on its own,
+    // and added up only when the palette is generated.
+    std::vector<std::vector<uint64_t>> histograms;
+
+    // ARGB colors, the same way as the palette of PAL8 frames.
+    std::array<uint32_t, 256> palette;
+    // Palette index of each 15-bit color.
+    std::vector<uint8_t> lookup_table;
+};
+}
+
+#endif
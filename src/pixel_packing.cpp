@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <pixel_packing.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ELEMENTARY_VISUALIZER_PIXEL_PACKING_X86
+#include <immintrin.h>
+#endif
+
+namespace elementary_visualizer
+{
+uint8_t to_8_bit(const float color)
+{
+    return std::clamp(int(255 * color), 0, 255);
+}
+
+// Every implementation truncates towards zero and then clamps,
+// so that the vectorized ones give exactly the same result
+// as the scalar one.
+static void pack_rgba_float_row_scalar(
+    const float *source,
+    const size_t width,
+    const PackedPixelFormat format,
+    uint8_t *destination
+)
+{
+    const size_t channels = format == PackedPixelFormat::rgba8 ? 4 : 3;
+    for (size_t x = 0; x < width; ++x)
+        for (size_t channel = 0; channel < channels; ++channel)
+            destination[channels * x + channel] =
+                to_8_bit(source[4 * x + channel]);
+}
+
+#ifdef ELEMENTARY_VISUALIZER_PIXEL_PACKING_X86
+// Processes 4 pixels at once.
+__attribute__((target("ssse3"))) static void pack_rgba_float_row_ssse3(
+    const float *source,
+    const size_t width,
+    const PackedPixelFormat format,
+    uint8_t *destination
+)
+{
+    const __m128 scale = _mm_set1_ps(255.0f);
+    // Moves the RGB of the 4 pixels into the first 12 bytes.
+    const __m128i drop_alpha = _mm_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+    );
+
+    size_t x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const float *pixels = source + 4 * x;
+        const __m128i p0 =
+            _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(pixels + 0), scale));
+        const __m128i p1 =
+            _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(pixels + 4), scale));
+        const __m128i p2 =
+            _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(pixels + 8), scale));
+        const __m128i p3 =
+            _mm_cvttps_epi32(_mm_mul_ps(_mm_loadu_ps(pixels + 12), scale));
+
+        // The saturating packs clamp into [0, 255].
+        const __m128i rgba = _mm_packus_epi16(
+            _mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3)
+        );
+
+        if (format == PackedPixelFormat::rgba8)
+        {
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(destination + 4 * x), rgba
+            );
+        }
+        else
+        {
+            const __m128i rgb = _mm_shuffle_epi8(rgba, drop_alpha);
+            uint8_t *row = destination + 3 * x;
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(row), rgb);
+            const int last_pixels = _mm_cvtsi128_si32(_mm_srli_si128(rgb, 8));
+            std::copy_n(
+                reinterpret_cast<const uint8_t *>(&last_pixels), 4, row + 8
+            );
+        }
+    }
+
+    pack_rgba_float_row_scalar(
+        source + 4 * x,
+        width - x,
+        format,
+        destination + (format == PackedPixelFormat::rgba8 ? 4 : 3) * x
+    );
+}
+
+// Processes 8 pixels at once.
+__attribute__((target("avx2"))) static void pack_rgba_float_row_avx2(
+    const float *source,
+    const size_t width,
+    const PackedPixelFormat format,
+    uint8_t *destination
+)
+{
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    // The packs work within the 128-bit lanes, so after packing the
+    // pixels are in the order 0, 2, 4, 6, 1, 3, 5, 7.
+    const __m256i reorder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    // Moves the RGB of the 4 pixels of each lane into its first 12 bytes.
+    const __m256i drop_alpha = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1
+    );
+    // Moves the RGB of the two lanes next to each other.
+    const __m256i join_lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const float *pixels = source + 4 * x;
+        const __m256i p0 = _mm256_cvttps_epi32(
+            _mm256_mul_ps(_mm256_loadu_ps(pixels + 0), scale)
+        );
+        const __m256i p1 = _mm256_cvttps_epi32(
+            _mm256_mul_ps(_mm256_loadu_ps(pixels + 8), scale)
+        );
+        const __m256i p2 = _mm256_cvttps_epi32(
+            _mm256_mul_ps(_mm256_loadu_ps(pixels + 16), scale)
+        );
+        const __m256i p3 = _mm256_cvttps_epi32(
+            _mm256_mul_ps(_mm256_loadu_ps(pixels + 24), scale)
+        );
+
+        // The saturating packs clamp into [0, 255].
+        const __m256i rgba = _mm256_permutevar8x32_epi32(
+            _mm256_packus_epi16(
+                _mm256_packs_epi32(p0, p1), _mm256_packs_epi32(p2, p3)
+            ),
+            reorder
+        );
+
+        if (format == PackedPixelFormat::rgba8)
+        {
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i *>(destination + 4 * x), rgba
+            );
+        }
+        else
+        {
+            const __m256i rgb = _mm256_permutevar8x32_epi32(
+                _mm256_shuffle_epi8(rgba, drop_alpha), join_lanes
+            );
+            uint8_t *row = destination + 3 * x;
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(row),
+                _mm256_castsi256_si128(rgb)
+            );
+            _mm_storel_epi64(
+                reinterpret_cast<__m128i *>(row + 16),
+                _mm256_extracti128_si256(rgb, 1)
+            );
+        }
+    }
+
+    pack_rgba_float_row_ssse3(
+        source + 4 * x,
+        width - x,
+        format,
+        destination + (format == PackedPixelFormat::rgba8 ? 4 : 3) * x
+    );
+}
+#endif
+
+using PackRgbaFloatRow =
+    void (*)(const float *, const size_t, const PackedPixelFormat, uint8_t *);
+
+bool is_pixel_packing_kernel_supported(const PixelPackingKernel kernel)
+{
+    switch (kernel)
+    {
+    case PixelPackingKernel::scalar:
+        return true;
+#ifdef ELEMENTARY_VISUALIZER_PIXEL_PACKING_X86
+    case PixelPackingKernel::ssse3:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3");
+    case PixelPackingKernel::avx2:
+        // The AVX2 kernel packs the remaining pixels with the SSSE3 one.
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") &&
+               __builtin_cpu_supports("ssse3");
+#endif
+    default:
+        return false;
+    }
+}
+
+static PackRgbaFloatRow get_pack_rgba_float_row(
+    const PixelPackingKernel kernel
+)
+{
+    switch (kernel)
+    {
+#ifdef ELEMENTARY_VISUALIZER_PIXEL_PACKING_X86
+    case PixelPackingKernel::ssse3:
+        return pack_rgba_float_row_ssse3;
+    case PixelPackingKernel::avx2:
+        return pack_rgba_float_row_avx2;
+#endif
+    default:
+        return pack_rgba_float_row_scalar;
+    }
+}
+
+static PackRgbaFloatRow select_pack_rgba_float_row()
+{
+    for (const auto kernel :
+         {PixelPackingKernel::avx2, PixelPackingKernel::ssse3})
+    {
+        if (is_pixel_packing_kernel_supported(kernel))
+            return get_pack_rgba_float_row(kernel);
+    }
+    return pack_rgba_float_row_scalar;
+}
+
+void pack_rgba_float_row(
+    const float *source,
+    const size_t width,
+    const PackedPixelFormat format,
+    uint8_t *destination
+)
+{
+    // The instruction set is only checked once.
+    static const PackRgbaFloatRow pack_row = select_pack_rgba_float_row();
+    pack_row(source, width, format, destination);
+}
+
+void pack_rgba_float_row(
+    const float *source,
+    const size_t width,
+    const PackedPixelFormat format,
+    uint8_t *destination,
+    const PixelPackingKernel kernel
+)
+{
+    get_pack_rgba_float_row(kernel)(source, width, format, destination);
+}
+
+void pack_rgba_float_image(
+    const float *source,
+    const glm::uvec2 &size,
+    const PackedPixelFormat format,
+    uint8_t *destination,
+    const size_t destination_linesize,
+    const bool flip_vertically
+)
+{
+    for (unsigned int y = 0; y < size.y; ++y)
+    {
+        const unsigned int destination_y =
+            flip_vertically ? (size.y - 1) - y : y;
+        pack_rgba_float_row(
+            source + 4 * static_cast<size_t>(size.x) * y,
+            size.x,
+            format,
+            destination + destination_linesize * destination_y
+        );
+    }
+}
+}
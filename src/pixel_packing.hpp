@@ -0,0 +1,67 @@
+#ifndef ELEMENTARY_VISUALIZER_PIXEL_PACKING_HPP
+#define ELEMENTARY_VISUALIZER_PIXEL_PACKING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace elementary_visualizer
+{
+enum class PackedPixelFormat
+{
+    rgb24,
+    rgba8
+};
+
+// The implementations of the row packing. They all give the same result;
+// the vectorized ones only run on processors with their instruction set.
+enum class PixelPackingKernel
+{
+    scalar,
+    ssse3,
+    avx2
+};
+
+// Converts one color component from [0, 1] to [0, 255],
+// truncating and clamping the same way as the packing functions.
+uint8_t to_8_bit(const float color);
+
+// Packs a row of RGBA float pixels into 8-bit pixels.
+// The alpha is dropped for RGB24.
+void pack_rgba_float_row(
+    const float *source,
+    const size_t width,
+    const PackedPixelFormat format,
+    uint8_t *destination
+);
+
+// Whether the kernel is compiled in and the processor can run it.
+bool is_pixel_packing_kernel_supported(const PixelPackingKernel kernel);
+
+// Packs a row with the given kernel, instead of the fastest supported one.
+// The kernel must be supported.
+void pack_rgba_float_row(
+    const float *source,
+    const size_t width,
+    const PackedPixelFormat format,
+    uint8_t *destination,
+    const PixelPackingKernel kernel
+);
+
+// Packs an RGBA float image (for example a texture read back from OpenGL)
+// into 8-bit pixels, row by row. The destination rows are
+// `destination_linesize` bytes apart. If `flip_vertically` is set,
+// the first source row becomes the last destination row;
+// OpenGL images start with the bottom row, but most image formats
+// start with the top row.
+void pack_rgba_float_image(
+    const float *source,
+    const glm::uvec2 &size,
+    const PackedPixelFormat format,
+    uint8_t *destination,
+    const size_t destination_linesize,
+    const bool flip_vertically
+);
+}
+
+#endif
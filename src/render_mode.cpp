@@ -0,0 +1,57 @@
+#include <glm/gtc/matrix_transform.hpp>
+#include <render_mode.hpp>
+
+namespace elementary_visualizer
+{
+glm::mat4 render_mode_model(const glm::uvec2 &scene_size)
+{
+    const float scene_width = static_cast<float>(scene_size.x);
+    const float scene_height = static_cast<float>(scene_size.y);
+    const float scene_aspect = scene_width / scene_height;
+
+    glm::vec3 scale = glm::vec3(scene_aspect, 1.0f, 1.0f);
+    return glm::scale(glm::mat4(1.0f), scale);
+}
+
+glm::mat4 render_mode_projection(
+    const RenderMode render_mode,
+    const glm::uvec2 &target_size,
+    const glm::uvec2 &scene_size
+)
+{
+    const float target_width = static_cast<float>(target_size.x);
+    const float target_height = static_cast<float>(target_size.y);
+    const float scene_width = static_cast<float>(scene_size.x);
+    const float scene_height = static_cast<float>(scene_size.y);
+    const float target_aspect = target_width / target_height;
+    const float scene_aspect = scene_width / scene_height;
+
+    glm::mat4 projection(1.0f);
+    if ((render_mode == RenderMode::fill && target_aspect > scene_aspect) ||
+        (render_mode == RenderMode::fit && target_aspect <= scene_aspect))
+    {
+        projection = glm::ortho(
+            -scene_aspect,
+            +scene_aspect,
+            -scene_aspect / target_aspect,
+            +scene_aspect / target_aspect
+        );
+    }
+    else if ((render_mode == RenderMode::fill &&
+              target_aspect <= scene_aspect) ||
+             (render_mode == RenderMode::fit && target_aspect > scene_aspect))
+    {
+        projection = glm::ortho(-target_aspect, +target_aspect, -1.0f, +1.0f);
+    }
+    else if (render_mode == RenderMode::absolute)
+    {
+        projection = glm::ortho(
+            -target_width / scene_height,
+            +target_width / scene_height,
+            -target_height / scene_height,
+            +target_height / scene_height
+        );
+    }
+    return projection;
+}
+}
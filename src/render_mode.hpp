@@ -0,0 +1,23 @@
+#ifndef ELEMENTARY_VISUALIZER_RENDER_MODE_HPP
+#define ELEMENTARY_VISUALIZER_RENDER_MODE_HPP
+
+#include <elementary_visualizer/elementary_visualizer.hpp>
+#include <glm/glm.hpp>
+
+namespace elementary_visualizer
+{
+// Model matrix of the quad which shows the rendered scene,
+// so that the quad has the aspect ratio of the scene.
+glm::mat4 render_mode_model(const glm::uvec2 &scene_size);
+
+// Projection matrix which places the quad of `render_mode_model`
+// into a target (e.g. a window or a video) of the given size,
+// according to the render mode.
+glm::mat4 render_mode_projection(
+    const RenderMode render_mode,
+    const glm::uvec2 &target_size,
+    const glm::uvec2 &scene_size
+);
+}
+
+#endif
@@ -1,8 +1,31 @@
+#include <algorithm>
 #include <glad/gl.h>
+#include <iterator>
+#include <limits>
 #include <scene.hpp>
 
 namespace elementary_visualizer
 {
+GLint color_internalformat(const RenderTargetPrecision precision)
+{
+    switch (precision)
+    {
+    case RenderTargetPrecision::rgba8:
+        return GL_RGBA8;
+    case RenderTargetPrecision::rgba16f:
+        return GL_RGBA16F;
+    case RenderTargetPrecision::rgba32f:
+        break;
+    }
+    return GL_RGBA32F;
+}
+
+GLint depth_internalformat(const RenderTargetPrecision precision)
+{
+    return precision == RenderTargetPrecision::rgba32f ? GL_DEPTH_COMPONENT32F
+                                                       : GL_DEPTH_COMPONENT24;
+}
+
 void depth_peeling_set_uniforms(
     std::shared_ptr<GlShaderProgram> shader_program,
     const DepthPeelingData &depth_peeling_data
@@ -11,13 +34,33 @@ void depth_peeling_set_uniforms(
     if (!shader_program || !depth_peeling_data.depth_texture)
         return;
 
+    shader_program->set_uniform(
+        "transparency_mode",
+        static_cast<int>(depth_peeling_data.transparency_mode)
+    );
+    shader_program->set_uniform(
+        "a_buffer_node_capacity", depth_peeling_data.a_buffer_node_capacity
+    );
     shader_program->set_uniform(
         "depth_peeling_first_pass", depth_peeling_data.first_pass
     );
+    shader_program->set_uniform(
+        "depth_peeling_premultiplied_alpha",
+        depth_peeling_data.premultiplied_alpha
+    );
     const bool multisampled =
         depth_peeling_data.depth_texture->samples.has_value();
     shader_program->set_uniform("depth_peeling_multisampled", multisampled);
 
+    // A fixed point depth is rounded when it is stored, so the fragments
+    // of the peeled layer can be slightly further than their stored depth.
+    const float depth_epsilon =
+        depth_peeling_data.depth_texture->get_internalformat() ==
+                GL_DEPTH_COMPONENT24
+            ? 1.0f / 16777215.0f
+            : 0.0f;
+    shader_program->set_uniform("depth_peeling_depth_epsilon", depth_epsilon);
+
     if (!multisampled)
         shader_program->set_uniform(
             "scene_size", depth_peeling_data.depth_texture->get_size()
@@ -40,6 +83,28 @@ void depth_peeling_set_uniforms(
             "depth_peeling_texture_slot_multisampled", texture_slot
         );
     }
+
+    // The same goes for the front texture of the dual depth peeling,
+    // which is substituted by the depth texture in the other modes.
+    std::shared_ptr<GlTexture> front_texture =
+        depth_peeling_data.front_texture ? depth_peeling_data.front_texture
+                                         : depth_peeling_data.depth_texture;
+    {
+        const int texture_slot = 2;
+        glActiveTexture(GL_TEXTURE0 + texture_slot);
+        front_texture->bind(false);
+        shader_program->set_uniform(
+            "dual_depth_peeling_front_texture_slot", texture_slot
+        );
+    }
+    {
+        const int texture_slot = 3;
+        glActiveTexture(GL_TEXTURE0 + texture_slot);
+        front_texture->bind(false);
+        shader_program->set_uniform(
+            "dual_depth_peeling_front_texture_slot_multisampled", texture_slot
+        );
+    }
 }
 
 Scene::Impl::Impl(
@@ -50,7 +115,22 @@ Scene::Impl::Impl(
     std::array<std::shared_ptr<GlTexture>, 2> depth_textures,
     std::vector<std::shared_ptr<GlFramebufferTexture>>
         depth_peeling_render_textures,
-    const glm::vec4 &background_color
+    const int depth_peeling_passes,
+    std::shared_ptr<GlTexture> depth_peeling_accumulation_texture,
+    std::vector<std::shared_ptr<GlQuery>> depth_peeling_queries,
+    std::shared_ptr<GlTexture> opaque_depth_texture,
+    std::shared_ptr<GlTexture> accumulation_texture,
+    std::shared_ptr<GlTexture> revealage_texture,
+    std::shared_ptr<GlShaderBuffer> a_buffer_heads,
+    std::shared_ptr<GlShaderBuffer> a_buffer_nodes,
+    const size_t a_buffer_node_capacity,
+    std::shared_ptr<GlShaderBuffer> a_buffer_node_count,
+    std::array<std::shared_ptr<GlTexture>, 2> dual_depth_textures,
+    std::array<std::shared_ptr<GlTexture>, 2> dual_front_textures,
+    std::shared_ptr<GlTexture> dual_back_texture,
+    const int dual_depth_peeling_passes,
+    const glm::vec4 &background_color,
+    const SceneOptions &options
 )
     : entity(entity),
       framebuffer_texture(framebuffer_texture),
@@ -59,6 +139,22 @@ Scene::Impl::Impl(
       ),
       depth_textures(depth_textures),
       depth_peeling_render_textures(depth_peeling_render_textures),
+      depth_peeling_passes(depth_peeling_passes),
+      depth_peeling_accumulation_texture(depth_peeling_accumulation_texture),
+      depth_peeling_queries(depth_peeling_queries),
+      opaque_depth_texture(opaque_depth_texture),
+      accumulation_texture(accumulation_texture),
+      revealage_texture(revealage_texture),
+      a_buffer_heads(a_buffer_heads),
+      a_buffer_nodes(a_buffer_nodes),
+      a_buffer_node_capacity(a_buffer_node_capacity),
+      a_buffer_node_count(a_buffer_node_count),
+      a_buffer_node_count_fence(nullptr),
+      dual_depth_textures(dual_depth_textures),
+      dual_front_textures(dual_front_textures),
+      dual_back_texture(dual_back_texture),
+      dual_depth_peeling_passes(dual_depth_peeling_passes),
+      options(options),
       background_color(background_color)
 {}
 
@@ -79,6 +175,62 @@ std::shared_ptr<const GlTexture> Scene::Impl::render()
     const glm::uvec2 scene_size =
         this->framebuffer_texture_possibly_multisampled->texture->get_size();
 
+    switch (this->options.transparency_mode)
+    {
+    case TransparencyMode::depth_peeling:
+        this->render_depth_peeling(scene_size);
+        break;
+    case TransparencyMode::weighted_blended:
+        this->render_weighted_blended(scene_size);
+        break;
+    case TransparencyMode::a_buffer:
+        this->render_a_buffer(scene_size);
+        break;
+    case TransparencyMode::dual_depth_peeling:
+        this->render_dual_depth_peeling(scene_size);
+        break;
+    }
+
+    // We convert the multisampled texture to non-multisampled texture, and
+    // return with that.
+    this->framebuffer_texture_possibly_multisampled->framebuffer->bind(
+        false, FrameBufferBindType::read
+    );
+    this->framebuffer_texture->framebuffer->bind(
+        false, FrameBufferBindType::draw
+    );
+    glBlitFramebuffer(
+        0,
+        0,
+        scene_size.x,
+        scene_size.y,
+        0,
+        0,
+        scene_size.x,
+        scene_size.y,
+        GL_COLOR_BUFFER_BIT,
+        GL_LINEAR
+    );
+
+    // Instead of waiting here until the rendering queue is finished,
+    // we leave a fence after it, and the consumers of the rendered texture
+    // wait for that only when they actually read it.
+    auto render_fence = this->entity->create_fence();
+    if (render_fence)
+        this->framebuffer_texture->texture->set_render_fence(
+            render_fence.value()
+        );
+    else
+    {
+        this->framebuffer_texture->texture->set_render_fence(nullptr);
+        glFinish();
+    }
+
+    return this->framebuffer_texture->texture;
+}
+
+void Scene::Impl::render_depth_peeling(const glm::uvec2 &scene_size)
+{
     // We implement here the depth peeling method. See
     // <https://en.wikipedia.org/wiki/Depth_peeling>,
     // Interactive Order-Independent Transparency, Cass Everitt,
@@ -87,6 +239,28 @@ std::shared_ptr<const GlTexture> Scene::Impl::render()
 
     this->framebuffer_texture_possibly_multisampled->framebuffer->bind(false);
 
+    // The opaque visuals are rendered only once, right onto the background,
+    // since nothing behind them can be seen. Only the translucent visuals
+    // are peeled, in front of the depth of the opaque ones.
+    this->clear_to_background(scene_size);
+    this->opaque_depth_texture->bind(false);
+    this->opaque_depth_texture->framebuffer_texture(false);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+
+    std::vector<std::shared_ptr<Visual>> translucent_visuals;
+    for (const auto &visual : this->visuals)
+    {
+        if (visual->is_opaque())
+            visual->render(
+                scene_size, DepthPeelingData(true, this->depth_textures[0])
+            );
+        else
+            translucent_visuals.push_back(visual);
+    }
+
     // Initialize depth textures.
     // This depth texture is the already "peeled" texture from the last pass.
     // In each pass, the rendered fragments cannot be nearer than this depth.
@@ -98,37 +272,87 @@ std::shared_ptr<const GlTexture> Scene::Impl::render()
     // value). This behaves like a regular depth buffer.
     std::shared_ptr<GlTexture> regular_depth_texture = this->depth_textures[1];
 
-    // Front to back rendering, while peeling away each front layers.
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
+    // When the layers are blended incrementally, each one is blended
+    // under the ones before it right after it is peeled, see
+    // Interactive Order-Independent Transparency, Cass Everitt.
+    // Nothing is accumulated yet.
+    const bool incremental = this->options.incremental_depth_peeling;
+    if (incremental)
+    {
+        this->depth_peeling_accumulation_texture->bind(false);
+        this->depth_peeling_accumulation_texture->framebuffer_texture(false);
+        glViewport(0, 0, scene_size.x, scene_size.y);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
 
+    // Front to back rendering, while peeling away each front layers.
     // We render each pass in a different texture, from front to back.
     // Each of these depth peeling passes will be rendered onto a different
-    // texture.
+    // texture, or onto the same one, if they are blended incrementally.
+    // Once a pass has nothing left to peel, the next ones would not find
+    // anything either. Instead of reading back the query of each pass,
+    // which would wait for the pass, each pass is rendered on condition
+    // of the query of the pass before it, so the GPU skips the rest
+    // of the passes, and each layer is blended on condition of its own.
     bool first_pass = true;
-    for (auto it = std::begin(this->depth_peeling_render_textures);
-         it != std::end(this->depth_peeling_render_textures);
-         ++it)
+    for (int pass = 0; pass < this->depth_peeling_passes; ++pass)
     {
+        std::shared_ptr<GlTexture> render_texture =
+            this->depth_peeling_render_textures[incremental ? 0 : pass]
+                ->texture;
+        const std::shared_ptr<GlQuery> &query =
+            this->depth_peeling_queries[pass];
+
+        if (!first_pass)
+            this->depth_peeling_queries[pass - 1]->begin_conditional_render(
+                false
+            );
+
         // Setup the rendering texture and depth texture for the depth peeling
         // pass.
-        (*it)->texture->bind(false);
-        (*it)->texture->framebuffer_texture(false);
+        render_texture->bind(false);
+        render_texture->framebuffer_texture(false);
         regular_depth_texture->bind(false);
         regular_depth_texture->framebuffer_texture(false);
 
         glViewport(0, 0, scene_size.x, scene_size.y);
 
-        // Clear rendering texture and depth texture.
+        // Clear rendering texture, and start the depth texture
+        // from the depth of the opaque visuals.
         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glClear(GL_COLOR_BUFFER_BIT);
+        regular_depth_texture->copy_image(*this->opaque_depth_texture, false);
 
-        // Render visuals.
-        for (const auto &visual : this->visuals)
-            visual->render(
-                scene_size, DepthPeelingData(first_pass, peeled_depth_texture)
+        // Render visuals, while counting whether any of their samples
+        // are kept.
+        DepthPeelingData depth_peeling_data(first_pass, peeled_depth_texture);
+        depth_peeling_data.premultiplied_alpha = incremental;
+        query->begin(false);
+        for (const auto &visual : translucent_visuals)
+            visual->render(scene_size, depth_peeling_data);
+        query->end(false);
+
+        if (!first_pass)
+            this->depth_peeling_queries[pass - 1]->end_conditional_render(
+                false
             );
-        glFinish();
+
+        // The layer is behind every layer accumulated so far.
+        if (incremental)
+        {
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE_MINUS_DST_ALPHA, GL_ONE);
+            this->depth_peeling_accumulation_texture->bind(false);
+            this->depth_peeling_accumulation_texture->framebuffer_texture(false
+            );
+            query->begin_conditional_render(false);
+            this->render_texture_quad(scene_size, render_texture);
+            query->end_conditional_render(false);
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+        }
 
         // Swap the peeled and regular depth texture, so that in the next pass
         // the regular depth texture becomes the already peeled away depth.
@@ -138,81 +362,454 @@ std::shared_ptr<const GlTexture> Scene::Impl::render()
 
     // Now, we render each depth peeled pass from the textures we rendered in
     // the previous loop, from back to front to a scene quad, but now, with
-    // proper alpha blending.
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // proper alpha blending. The empty layers are left out.
     glEnable(GL_BLEND);
     glDisable(GL_DEPTH_TEST);
 
     this->framebuffer_texture_possibly_multisampled->texture->bind(false);
     this->framebuffer_texture_possibly_multisampled->texture
         ->framebuffer_texture(false);
-
     glViewport(0, 0, scene_size.x, scene_size.y);
 
-    glClearColor(
-        this->background_color.r,
-        this->background_color.g,
-        this->background_color.b,
-        this->background_color.a
+    // The incrementally blended layers are already accumulated,
+    // premultiplied by their alpha.
+    if (incremental)
+    {
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        this->render_texture_quad(
+            scene_size, this->depth_peeling_accumulation_texture
+        );
+        return;
+    }
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    for (int pass = this->depth_peeling_passes - 1; pass >= 0; --pass)
+    {
+        this->depth_peeling_queries[pass]->begin_conditional_render(false);
+        this->render_texture_quad(
+            scene_size, this->depth_peeling_render_textures[pass]->texture
+        );
+        this->depth_peeling_queries[pass]->end_conditional_render(false);
+    }
+}
+
+void Scene::Impl::render_dual_depth_peeling(const glm::uvec2 &scene_size)
+{
+    // We implement here the dual depth peeling method. See
+    // Order Independent Transparency with Dual Depth Peeling,
+    // Louis Bavoil and Kevin Myers,
+    // <https://developer.download.nvidia.com/SDK/10/opengl/src/dual_depth_peeling/doc/DualDepthPeeling.pdf>.
+
+    // The opaque visuals are rendered only once, right onto
+    // the background, with their depth. The back layers are blended
+    // over them right after they are peeled, from back to front.
+    this->framebuffer_texture_possibly_multisampled->framebuffer->bind(false);
+    this->clear_to_background(scene_size);
+    this->opaque_depth_texture->bind(false);
+    this->opaque_depth_texture->framebuffer_texture(false);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+
+    std::vector<std::shared_ptr<Visual>> translucent_visuals;
+    for (const auto &visual : this->visuals)
+    {
+        if (visual->is_opaque())
+            visual->render(
+                scene_size, DepthPeelingData(true, this->depth_textures[0])
+            );
+        else
+            translucent_visuals.push_back(visual);
+    }
+
+    // The peeled depths are compared sample by sample,
+    // so each sample has to be shaded on its own.
+    const bool multisampled = this->framebuffer_texture_possibly_multisampled
+                                  ->texture->samples.has_value();
+    if (multisampled)
+    {
+        glEnable(GL_SAMPLE_SHADING);
+        glMinSampleShading(1.0f);
+    }
+    glEnable(GL_BLEND);
+
+    const GLenum draw_buffers[3] = {
+        GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2
+    };
+    // Nothing is left to peel, and nothing is blended yet.
+    const GLfloat depth_clear[4] = {-1.0f, -1.0f, 0.0f, 0.0f};
+    const GLfloat color_clear[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    // The first pass only finds the nearest and the furthest depth,
+    // and each further pass peels the layers at those depths,
+    // while finding the depths of the next ones.
+    for (int pass = 0; pass <= this->dual_depth_peeling_passes; ++pass)
+    {
+        const bool first_pass = pass == 0;
+        const int current = pass % 2;
+        const int previous = 1 - current;
+
+        this->dual_depth_textures[current]->bind(false);
+        this->dual_depth_textures[current]->framebuffer_texture(false);
+        this->dual_front_textures[current]->bind(false);
+        this->dual_front_textures[current]->framebuffer_texture(false, 1);
+        if (!first_pass)
+        {
+            this->dual_back_texture->bind(false);
+            this->dual_back_texture->framebuffer_texture(false, 2);
+        }
+        glDrawBuffers(first_pass ? 2 : 3, draw_buffers);
+
+        glViewport(0, 0, scene_size.x, scene_size.y);
+
+        glClearBufferfv(GL_COLOR, 0, depth_clear);
+        glClearBufferfv(GL_COLOR, 1, color_clear);
+        if (!first_pass)
+            glClearBufferfv(GL_COLOR, 2, color_clear);
+
+        // Only the translucent visuals are peeled. The depth
+        // of the opaque ones stays attached, and it is only tested,
+        // so that nothing behind them is peeled.
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBlendEquation(GL_MAX);
+        for (const auto &visual : translucent_visuals)
+            visual->render(
+                scene_size,
+                first_pass ? DepthPeelingData(
+                                 true,
+                                 this->depth_textures[0],
+                                 TransparencyMode::dual_depth_peeling
+                             )
+                           : DepthPeelingData(
+                                 false,
+                                 this->dual_depth_textures[previous],
+                                 TransparencyMode::dual_depth_peeling,
+                                 0,
+                                 this->dual_front_textures[previous]
+                             )
+            );
+        glBlendEquation(GL_FUNC_ADD);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_DEPTH_TEST);
+
+        this->reset_to_single_color_attachment();
+        this->framebuffer_texture_possibly_multisampled->texture->bind(false);
+        this->framebuffer_texture_possibly_multisampled->texture
+            ->framebuffer_texture(false);
+
+        // The back layer of the pass is in front of the ones
+        // blended before.
+        if (!first_pass)
+        {
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            this->render_texture_quad(scene_size, this->dual_back_texture);
+        }
+    }
+
+    // The front layers, which are premultiplied by their alpha,
+    // are blended over the back layers.
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    this->render_texture_quad(
+        scene_size,
+        this->dual_front_textures[this->dual_depth_peeling_passes % 2]
     );
-    glClear(GL_COLOR_BUFFER_BIT);
+
+    glDisable(GL_SAMPLE_SHADING);
+}
+
+void Scene::Impl::render_weighted_blended(const glm::uvec2 &scene_size)
+{
+    // We implement here the weighted blended order-independent transparency.
+    // See Weighted Blended Order-Independent Transparency,
+    // Morgan McGuire and Louis Bavoil,
+    // <https://jcgt.org/published/0002/02/09/>.
+
+    this->framebuffer_texture_possibly_multisampled->framebuffer->bind(false);
+
+    // The opaque visuals are rendered first, right onto the background,
+    // with their depth, so that they hide the translucent fragments
+    // behind them, and they are not weighted in with the others.
+    this->clear_to_background(scene_size);
+    this->opaque_depth_texture->bind(false);
+    this->opaque_depth_texture->framebuffer_texture(false);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+
+    std::vector<std::shared_ptr<Visual>> translucent_visuals;
+    for (const auto &visual : this->visuals)
+    {
+        if (visual->is_opaque())
+            visual->render(
+                scene_size, DepthPeelingData(true, this->depth_textures[0])
+            );
+        else
+            translucent_visuals.push_back(visual);
+    }
+
+    // Every translucent fragment in front of the opaque ones is rendered
+    // in a single pass into the accumulation and the revealage textures,
+    // in any order. The depth of the opaque visuals is kept attached,
+    // and it is only tested, not written.
+    this->accumulation_texture->bind(false);
+    this->accumulation_texture->framebuffer_texture(false);
+    this->revealage_texture->bind(false);
+    this->revealage_texture->framebuffer_texture(false, 1);
+    const GLenum draw_buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, draw_buffers);
+
+    glViewport(0, 0, scene_size.x, scene_size.y);
+
+    // Nothing is accumulated, and the background is fully revealed.
+    const GLfloat accumulation_clear[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    const GLfloat revealage_clear[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glClearBufferfv(GL_COLOR, 0, accumulation_clear);
+    glClearBufferfv(GL_COLOR, 1, revealage_clear);
+
+    // The accumulation is summed up, and the revealage
+    // is multiplied by the transparency of each fragment.
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+
+    for (const auto &visual : translucent_visuals)
+        visual->render(
+            scene_size,
+            DepthPeelingData(
+                true,
+                this->depth_textures[0],
+                TransparencyMode::weighted_blended
+            )
+        );
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_DEPTH_TEST);
+
+    this->reset_to_single_color_attachment();
+
+    // The average color of the fragments is blended over the opaque
+    // visuals and the background.
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    this->framebuffer_texture_possibly_multisampled->texture->bind(false);
+    this->framebuffer_texture_possibly_multisampled->texture
+        ->framebuffer_texture(false);
+    glViewport(0, 0, scene_size.x, scene_size.y);
 
     const bool multisampled = this->framebuffer_texture_possibly_multisampled
                                   ->texture->samples.has_value();
     std::shared_ptr<GlShaderProgram> shader_program =
-        multisampled ? this->entity->quad_multisampled_shader_program
-                     : this->entity->quad_shader_program;
+        multisampled
+            ? this->entity
+                  ->weighted_blended_composite_multisampled_shader_program
+            : this->entity->weighted_blended_composite_shader_program;
     shader_program->use(false);
 
     shader_program->set_uniform("model", glm::mat4(1.0f));
     shader_program->set_uniform("view", glm::mat4(1.0f));
     shader_program->set_uniform("projection", glm::mat4(1.0f));
+    if (multisampled)
+        shader_program->set_uniform("scene_size", scene_size);
 
-    for (auto it = std::rbegin(this->depth_peeling_render_textures);
-         it != std::rend(this->depth_peeling_render_textures);
-         ++it)
     {
-        if (multisampled)
-            shader_program->set_uniform("scene_size", scene_size);
-
         const int texture_slot = 0;
         glActiveTexture(GL_TEXTURE0 + texture_slot);
-        (*it)->texture->bind(false);
-        shader_program->set_uniform("texture_slot", texture_slot);
+        this->accumulation_texture->bind(false);
+        shader_program->set_uniform("accumulation_texture_slot", texture_slot);
+    }
+    {
+        const int texture_slot = 1;
+        glActiveTexture(GL_TEXTURE0 + texture_slot);
+        this->revealage_texture->bind(false);
+        shader_program->set_uniform("revealage_texture_slot", texture_slot);
+    }
+
+    this->entity->quad->render();
+}
 
-        this->entity->quad->render();
+// Size of a node of the A-buffer, see shader_sources_a_buffer.cpp.
+static const size_t a_buffer_node_size = 32;
+
+void Scene::Impl::render_a_buffer(const glm::uvec2 &scene_size)
+{
+    // We implement here the A-buffer with per-pixel linked lists. See
+    // Real-Time Concurrent Linked List Construction on the GPU,
+    // Jason C. Yang, Justin Hensley, Holger Grün and Nicolas Thibieroz,
+    // <https://doi.org/10.1111/j.1467-8659.2010.01725.x>.
+
+    // The number of fragments of an earlier frame is read back once
+    // that frame is done, instead of waiting for the fragments
+    // of this one. If they did not fit, the node buffer is grown
+    // for this frame.
+    if (this->a_buffer_node_count_fence &&
+        this->a_buffer_node_count_fence->is_signaled(false))
+    {
+        GLuint node_count = 0;
+        this->a_buffer_node_count->bind(false);
+        glGetBufferSubData(
+            GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &node_count
+        );
+        this->a_buffer_node_count_fence = nullptr;
+
+        if (node_count > this->a_buffer_node_capacity)
+        {
+            this->a_buffer_node_capacity = std::min<size_t>(
+                node_count + node_count / 2, std::numeric_limits<int>::max()
+            );
+            this->a_buffer_nodes->bind(false);
+            glBufferData(
+                GL_SHADER_STORAGE_BUFFER,
+                a_buffer_node_size * this->a_buffer_node_capacity,
+                nullptr,
+                GL_DYNAMIC_COPY
+            );
+        }
     }
 
-    // Waiting until the rendering queue is finished,
-    // so that we will return a rendered texture.
-    glFinish();
+    this->render_a_buffer_fragments(scene_size);
 
-    // We convert the multisampled texture to non-multisampled texture, and
-    // return with that.
-    this->framebuffer_texture_possibly_multisampled->framebuffer->bind(
-        false, FrameBufferBindType::read
+    // The counter is copied aside, so that the next frames can clear it,
+    // while the copy is read back. Until it is read, the later counters
+    // are not copied.
+    if (!this->a_buffer_node_count_fence)
+    {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        this->a_buffer_node_count->copy_sub_data(
+            *this->a_buffer_heads, sizeof(GLuint), false
+        );
+        Expected<std::shared_ptr<GlFence>, Error> node_count_fence =
+            this->entity->create_fence();
+        if (node_count_fence)
+            this->a_buffer_node_count_fence = node_count_fence.value();
+    }
+
+    // The lists have to be complete before they are resolved.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // The sorted fragments of each pixel are blended over the background.
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_BLEND);
+
+    this->clear_to_background(scene_size);
+
+    std::shared_ptr<GlShaderProgram> shader_program =
+        this->entity->a_buffer_resolve_shader_program;
+    shader_program->use(false);
+
+    shader_program->set_uniform("model", glm::mat4(1.0f));
+    shader_program->set_uniform("view", glm::mat4(1.0f));
+    shader_program->set_uniform("projection", glm::mat4(1.0f));
+    shader_program->set_uniform("scene_size", scene_size);
+    shader_program->set_uniform(
+        "multisampled",
+        this->framebuffer_texture_possibly_multisampled->texture->samples
+            .has_value()
     );
-    this->framebuffer_texture->framebuffer->bind(
-        false, FrameBufferBindType::draw
+
+    this->entity->quad->render();
+}
+
+void Scene::Impl::render_a_buffer_fragments(const glm::uvec2 &scene_size)
+{
+    // Every list is empty, and no node is used.
+    const GLuint end = 0xffffffff;
+    const GLuint zero = 0;
+    this->a_buffer_heads->bind(false);
+    glClearBufferData(
+        GL_SHADER_STORAGE_BUFFER,
+        GL_R32UI,
+        GL_RED_INTEGER,
+        GL_UNSIGNED_INT,
+        &end
     );
-    glBlitFramebuffer(
-        0,
+    glClearBufferSubData(
+        GL_SHADER_STORAGE_BUFFER,
+        GL_R32UI,
         0,
-        scene_size.x,
-        scene_size.y,
-        0,
-        0,
-        scene_size.x,
-        scene_size.y,
-        GL_COLOR_BUFFER_BIT,
-        GL_LINEAR
+        sizeof(GLuint),
+        GL_RED_INTEGER,
+        GL_UNSIGNED_INT,
+        &zero
     );
+    this->a_buffer_heads->bind_buffer_base(3, false);
+    this->a_buffer_nodes->bind_buffer_base(4, false);
 
-    // Waiting until the rendering queue is finished,
-    // so that we will return a rendered texture.
-    glFinish();
+    // The fragments are only stored in the buffers, but they are
+    // rasterized with the samples of the scene for their coverage.
+    this->framebuffer_texture_possibly_multisampled->framebuffer->bind(false);
+    glViewport(0, 0, scene_size.x, scene_size.y);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
 
-    return this->framebuffer_texture->texture;
+    const int node_capacity = static_cast<int>(this->a_buffer_node_capacity);
+    for (const auto &visual : this->visuals)
+        visual->render(
+            scene_size,
+            DepthPeelingData(
+                true,
+                this->depth_textures[0],
+                TransparencyMode::a_buffer,
+                node_capacity
+            )
+        );
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void Scene::Impl::reset_to_single_color_attachment()
+{
+    // The other color attachments are detached, so that the framebuffer
+    // is left with a single attachment, as the others expect it.
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, 0, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, 0, 0);
+    const GLenum draw_buffer = GL_COLOR_ATTACHMENT0;
+    glDrawBuffers(1, &draw_buffer);
+}
+
+void Scene::Impl::clear_to_background(const glm::uvec2 &scene_size)
+{
+    this->framebuffer_texture_possibly_multisampled->texture->bind(false);
+    this->framebuffer_texture_possibly_multisampled->texture
+        ->framebuffer_texture(false);
+
+    glViewport(0, 0, scene_size.x, scene_size.y);
+
+    glClearColor(
+        this->background_color.r,
+        this->background_color.g,
+        this->background_color.b,
+        this->background_color.a
+    );
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void Scene::Impl::render_texture_quad(
+    const glm::uvec2 &scene_size, std::shared_ptr<GlTexture> texture
+)
+{
+    const bool multisampled = texture->samples.has_value();
+    std::shared_ptr<GlShaderProgram> shader_program =
+        multisampled ? this->entity->quad_multisampled_shader_program
+                     : this->entity->quad_shader_program;
+    shader_program->use(false);
+
+    shader_program->set_uniform("model", glm::mat4(1.0f));
+    shader_program->set_uniform("view", glm::mat4(1.0f));
+    shader_program->set_uniform("projection", glm::mat4(1.0f));
+    if (multisampled)
+        shader_program->set_uniform("scene_size", scene_size);
+
+    const int texture_slot = 0;
+    glActiveTexture(GL_TEXTURE0 + texture_slot);
+    texture->bind(false);
+    shader_program->set_uniform("texture_slot", texture_slot);
+
+    this->entity->quad->render();
 }
 
 glm::uvec2 Scene::Impl::get_size() const
@@ -226,49 +823,224 @@ Expected<std::shared_ptr<Scene>, Error> Scene::create(
     const glm::uvec2 &size,
     const glm::vec4 &background_color,
     const std::optional<int> samples,
-    const int depth_peeling_passes
+    const int depth_peeling_passes,
+    const SceneOptions &options
 )
 {
     return Entity::ensure_initialized_and_get().and_then(
-        [&size, &background_color, &samples, &depth_peeling_passes](
+        [&size, &background_color, &samples, &depth_peeling_passes, &options](
             std::shared_ptr<Entity> entity
         ) -> Expected<std::shared_ptr<Scene>, Error>
         {
+            const GLint color_format = color_internalformat(options.precision);
+            const GLint depth_format = depth_internalformat(options.precision);
+
             Expected<std::shared_ptr<GlFramebufferTexture>, Error>
-                framebuffer_texture =
-                    entity->create_framebuffer_texture(size, std::nullopt);
+                framebuffer_texture = entity->create_framebuffer_texture(
+                    size, std::nullopt, color_format
+                );
             if (!framebuffer_texture)
                 return Unexpected<Error>(Error());
 
             Expected<std::shared_ptr<GlFramebufferTexture>, Error>
                 framebuffer_texture_possibly_multisampled =
-                    entity->create_framebuffer_texture(size, samples);
+                    entity->create_framebuffer_texture(
+                        size, samples, color_format
+                    );
             if (!framebuffer_texture_possibly_multisampled)
                 return Unexpected<Error>(Error());
 
             Expected<std::shared_ptr<GlTexture>, Error> depth_texture_0 =
-                entity->create_texture(size, true, samples);
+                entity->create_texture(size, true, samples, depth_format);
             if (!depth_texture_0)
                 return Unexpected<Error>(Error());
 
             Expected<std::shared_ptr<GlTexture>, Error> depth_texture_1 =
-                entity->create_texture(size, true, samples);
+                entity->create_texture(size, true, samples, depth_format);
             if (!depth_texture_1)
                 return Unexpected<Error>(Error());
 
+            const bool depth_peeling =
+                options.transparency_mode == TransparencyMode::depth_peeling;
+            const bool weighted_blended =
+                options.transparency_mode == TransparencyMode::weighted_blended;
+            const bool a_buffer =
+                options.transparency_mode == TransparencyMode::a_buffer;
+            const bool dual_depth_peeling =
+                options.transparency_mode ==
+                TransparencyMode::dual_depth_peeling;
+
+            // The incrementally blended passes share a single texture.
+            const int depth_peeling_render_texture_count =
+                options.incremental_depth_peeling
+                    ? std::min(depth_peeling_passes, 1)
+                    : depth_peeling_passes;
             std::vector<std::shared_ptr<GlFramebufferTexture>>
                 depth_peeling_render_textures;
-            for (int i = 0; i < depth_peeling_passes; ++i)
+            for (int i = 0;
+                 depth_peeling && i < depth_peeling_render_texture_count;
+                 ++i)
             {
                 Expected<std::shared_ptr<GlFramebufferTexture>, Error>
-                    render_texture =
-                        entity->create_framebuffer_texture(size, samples);
+                    render_texture = entity->create_framebuffer_texture(
+                        size, samples, color_format
+                    );
                 if (!render_texture)
                     return Unexpected<Error>(Error());
 
                 depth_peeling_render_textures.push_back(render_texture.value());
             }
 
+            std::vector<std::shared_ptr<GlQuery>> depth_peeling_queries;
+            std::shared_ptr<GlTexture> opaque_depth_texture;
+            for (int i = 0; depth_peeling && i < depth_peeling_passes; ++i)
+            {
+                Expected<std::shared_ptr<GlQuery>, Error> query =
+                    entity->create_query(GL_ANY_SAMPLES_PASSED);
+                if (!query)
+                    return Unexpected<Error>(Error());
+                depth_peeling_queries.push_back(query.value());
+            }
+            if (depth_peeling || weighted_blended || dual_depth_peeling)
+            {
+                Expected<std::shared_ptr<GlTexture>, Error>
+                    tmp_opaque_depth_texture = entity->create_texture(
+                        size, true, samples, depth_format
+                    );
+                if (!tmp_opaque_depth_texture)
+                    return Unexpected<Error>(Error());
+                opaque_depth_texture = tmp_opaque_depth_texture.value();
+            }
+
+            std::shared_ptr<GlTexture> depth_peeling_accumulation_texture;
+            if (depth_peeling && options.incremental_depth_peeling)
+            {
+                Expected<std::shared_ptr<GlTexture>, Error>
+                    tmp_accumulation_texture = entity->create_texture(
+                        size, false, samples, color_format
+                    );
+                if (!tmp_accumulation_texture)
+                    return Unexpected<Error>(Error());
+                depth_peeling_accumulation_texture =
+                    tmp_accumulation_texture.value();
+            }
+
+            std::shared_ptr<GlShaderBuffer> a_buffer_heads;
+            std::shared_ptr<GlShaderBuffer> a_buffer_nodes;
+            size_t a_buffer_node_capacity = 0;
+            std::shared_ptr<GlShaderBuffer> a_buffer_node_count;
+            if (a_buffer)
+            {
+                Expected<std::shared_ptr<GlShaderBuffer>, Error>
+                    tmp_a_buffer_heads = entity->create_shader_buffer();
+                if (!tmp_a_buffer_heads)
+                    return Unexpected<Error>(Error());
+                a_buffer_heads = tmp_a_buffer_heads.value();
+                a_buffer_heads->bind();
+                glBufferData(
+                    GL_SHADER_STORAGE_BUFFER,
+                    sizeof(GLuint) * (1 + size.x * size.y),
+                    nullptr,
+                    GL_DYNAMIC_COPY
+                );
+
+                Expected<std::shared_ptr<GlShaderBuffer>, Error>
+                    tmp_a_buffer_nodes = entity->create_shader_buffer();
+                if (!tmp_a_buffer_nodes)
+                    return Unexpected<Error>(Error());
+                a_buffer_nodes = tmp_a_buffer_nodes.value();
+                a_buffer_node_capacity = std::clamp<size_t>(
+                    static_cast<size_t>(
+                        std::max(options.a_buffer_fragments_per_pixel, 0.0f) *
+                        size.x * size.y
+                    ),
+                    1,
+                    std::numeric_limits<int>::max()
+                );
+                a_buffer_nodes->bind();
+                glBufferData(
+                    GL_SHADER_STORAGE_BUFFER,
+                    a_buffer_node_size * a_buffer_node_capacity,
+                    nullptr,
+                    GL_DYNAMIC_COPY
+                );
+
+                Expected<std::shared_ptr<GlShaderBuffer>, Error>
+                    tmp_a_buffer_node_count = entity->create_shader_buffer();
+                if (!tmp_a_buffer_node_count)
+                    return Unexpected<Error>(Error());
+                a_buffer_node_count = tmp_a_buffer_node_count.value();
+                a_buffer_node_count->bind();
+                glBufferData(
+                    GL_SHADER_STORAGE_BUFFER,
+                    sizeof(GLuint),
+                    nullptr,
+                    GL_STREAM_READ
+                );
+            }
+
+            std::shared_ptr<GlTexture> accumulation_texture;
+            std::shared_ptr<GlTexture> revealage_texture;
+            if (weighted_blended)
+            {
+                // The weighted sums do not fit into 8 bits.
+                Expected<std::shared_ptr<GlTexture>, Error>
+                    tmp_accumulation_texture = entity->create_texture(
+                        size,
+                        false,
+                        samples,
+                        options.precision == RenderTargetPrecision::rgba8
+                            ? GL_RGBA16F
+                            : color_format
+                    );
+                if (!tmp_accumulation_texture)
+                    return Unexpected<Error>(Error());
+                accumulation_texture = tmp_accumulation_texture.value();
+
+                Expected<std::shared_ptr<GlTexture>, Error>
+                    tmp_revealage_texture =
+                        entity->create_texture(size, false, samples, GL_R16F);
+                if (!tmp_revealage_texture)
+                    return Unexpected<Error>(Error());
+                revealage_texture = tmp_revealage_texture.value();
+            }
+
+            std::array<std::shared_ptr<GlTexture>, 2> dual_depth_textures;
+            std::array<std::shared_ptr<GlTexture>, 2> dual_front_textures;
+            std::shared_ptr<GlTexture> dual_back_texture;
+            if (dual_depth_peeling)
+            {
+                for (size_t i = 0; i < 2; ++i)
+                {
+                    Expected<std::shared_ptr<GlTexture>, Error>
+                        dual_depth_texture = entity->create_texture(
+                            size, false, samples, GL_RG32F
+                        );
+                    if (!dual_depth_texture)
+                        return Unexpected<Error>(Error());
+                    dual_depth_textures[i] = dual_depth_texture.value();
+
+                    Expected<std::shared_ptr<GlTexture>, Error>
+                        dual_front_texture = entity->create_texture(
+                            size, false, samples, color_format
+                        );
+                    if (!dual_front_texture)
+                        return Unexpected<Error>(Error());
+                    dual_front_textures[i] = dual_front_texture.value();
+                }
+
+                Expected<std::shared_ptr<GlTexture>, Error>
+                    tmp_dual_back_texture = entity->create_texture(
+                        size, false, samples, color_format
+                    );
+                if (!tmp_dual_back_texture)
+                    return Unexpected<Error>(Error());
+                dual_back_texture = tmp_dual_back_texture.value();
+            }
+            // Each pass peels two layers.
+            const int dual_depth_peeling_passes =
+                std::max(depth_peeling_passes + 1, 0) / 2;
+
             std::unique_ptr<Scene::Impl> impl(std::make_unique<Impl>(
                 entity,
                 framebuffer_texture.value(),
@@ -277,7 +1049,22 @@ Expected<std::shared_ptr<Scene>, Error> Scene::create(
                     {depth_texture_0.value(), depth_texture_1.value()}
                 ),
                 depth_peeling_render_textures,
-                background_color
+                std::max(depth_peeling_passes, 0),
+                depth_peeling_accumulation_texture,
+                depth_peeling_queries,
+                opaque_depth_texture,
+                accumulation_texture,
+                revealage_texture,
+                a_buffer_heads,
+                a_buffer_nodes,
+                a_buffer_node_capacity,
+                a_buffer_node_count,
+                dual_depth_textures,
+                dual_front_textures,
+                dual_back_texture,
+                dual_depth_peeling_passes,
+                background_color,
+                options
             ));
 
             return std::shared_ptr<Scene>(new Scene(std::move(impl)));
@@ -326,4 +1113,13 @@ glm::uvec2 Scene::get_size() const
 Scene::~Scene() {}
 
 Scene::Scene(std::unique_ptr<Scene::Impl> &&impl) : impl(std::move(impl)) {}
+
+Expected<void, Error> wait_until_rendered(
+    const std::shared_ptr<const RenderedScene> &rendered_scene
+)
+{
+    if (!rendered_scene)
+        return Unexpected<Error>(Error());
+    return rendered_scene->client_wait_rendered();
+}
 }
@@ -15,8 +15,26 @@ struct DepthPeelingData
 {
     bool first_pass;
     std::shared_ptr<GlTexture> depth_texture;
-    DepthPeelingData(bool first_pass, std::shared_ptr<GlTexture> depth_texture)
-        : first_pass(first_pass), depth_texture(depth_texture)
+    TransparencyMode transparency_mode;
+    // Number of fragments the A-buffer can hold.
+    int a_buffer_node_capacity;
+    // The front layers blended in the previous dual depth peeling pass.
+    std::shared_ptr<GlTexture> front_texture;
+    // Whether the depth peeling layer is premultiplied by its alpha.
+    bool premultiplied_alpha;
+    DepthPeelingData(
+        bool first_pass,
+        std::shared_ptr<GlTexture> depth_texture,
+        TransparencyMode transparency_mode = TransparencyMode::depth_peeling,
+        int a_buffer_node_capacity = 0,
+        std::shared_ptr<GlTexture> front_texture = nullptr
+    )
+        : first_pass(first_pass),
+          depth_texture(depth_texture),
+          transparency_mode(transparency_mode),
+          a_buffer_node_capacity(a_buffer_node_capacity),
+          front_texture(front_texture),
+          premultiplied_alpha(false)
     {}
 };
 
@@ -37,7 +55,22 @@ public:
         std::array<std::shared_ptr<GlTexture>, 2> depth_textures,
         std::vector<std::shared_ptr<GlFramebufferTexture>>
             depth_peeling_render_textures,
-        const glm::vec4 &background_color
+        const int depth_peeling_passes,
+        std::shared_ptr<GlTexture> depth_peeling_accumulation_texture,
+        std::vector<std::shared_ptr<GlQuery>> depth_peeling_queries,
+        std::shared_ptr<GlTexture> opaque_depth_texture,
+        std::shared_ptr<GlTexture> accumulation_texture,
+        std::shared_ptr<GlTexture> revealage_texture,
+        std::shared_ptr<GlShaderBuffer> a_buffer_heads,
+        std::shared_ptr<GlShaderBuffer> a_buffer_nodes,
+        const size_t a_buffer_node_capacity,
+        std::shared_ptr<GlShaderBuffer> a_buffer_node_count,
+        std::array<std::shared_ptr<GlTexture>, 2> dual_depth_textures,
+        std::array<std::shared_ptr<GlTexture>, 2> dual_front_textures,
+        std::shared_ptr<GlTexture> dual_back_texture,
+        const int dual_depth_peeling_passes,
+        const glm::vec4 &background_color,
+        const SceneOptions &options
     );
 
     void add_visual(std::shared_ptr<Visual> visual);
@@ -56,6 +89,28 @@ public:
 
 private:
 
+    // Renders the transparent visuals into the textures,
+    // and blends them over the background into the possibly
+    // multisampled framebuffer texture.
+    void render_depth_peeling(const glm::uvec2 &scene_size);
+    void render_weighted_blended(const glm::uvec2 &scene_size);
+    void render_a_buffer(const glm::uvec2 &scene_size);
+    void render_dual_depth_peeling(const glm::uvec2 &scene_size);
+    // Renders the visuals into the A-buffer, counting their fragments
+    // in the head buffer, even the ones which do not fit.
+    void render_a_buffer_fragments(const glm::uvec2 &scene_size);
+    // Leaves the bound framebuffer with only its first color attachment,
+    // after a pass which rendered into several ones.
+    void reset_to_single_color_attachment();
+    // Binds the possibly multisampled framebuffer texture,
+    // and clears it to the background.
+    void clear_to_background(const glm::uvec2 &scene_size);
+    // Renders the texture with the current blending onto the bound
+    // framebuffer, sample by sample if multisampled.
+    void render_texture_quad(
+        const glm::uvec2 &scene_size, std::shared_ptr<GlTexture> texture
+    );
+
     std::shared_ptr<Entity> entity;
     std::shared_ptr<GlFramebufferTexture> framebuffer_texture;
     std::shared_ptr<GlFramebufferTexture>
@@ -63,6 +118,38 @@ private:
     std::array<std::shared_ptr<GlTexture>, 2> depth_textures;
     std::vector<std::shared_ptr<GlFramebufferTexture>>
         depth_peeling_render_textures;
+    int depth_peeling_passes;
+    // The layers blended front to back, only used by the incrementally
+    // blended depth peeling.
+    std::shared_ptr<GlTexture> depth_peeling_accumulation_texture;
+    // Finds out whether each depth peeling pass has peeled any sample.
+    std::vector<std::shared_ptr<GlQuery>> depth_peeling_queries;
+    // The depth of the opaque visuals, behind which nothing is peeled
+    // or accumulated, only used by the depth peeling, the dual depth
+    // peeling and the weighted blended transparency.
+    std::shared_ptr<GlTexture> opaque_depth_texture;
+    // The weighted sum of the fragment colors and the product
+    // of their transparencies, only used by the weighted blended
+    // transparency.
+    std::shared_ptr<GlTexture> accumulation_texture;
+    std::shared_ptr<GlTexture> revealage_texture;
+    // The counter and the head of the fragment list of each pixel,
+    // and the fragments, only used by the A-buffer transparency.
+    std::shared_ptr<GlShaderBuffer> a_buffer_heads;
+    std::shared_ptr<GlShaderBuffer> a_buffer_nodes;
+    size_t a_buffer_node_capacity;
+    // The fragment counter of an earlier frame, copied aside to be read
+    // back after the fence, only used by the A-buffer transparency.
+    std::shared_ptr<GlShaderBuffer> a_buffer_node_count;
+    std::shared_ptr<const GlFence> a_buffer_node_count_fence;
+    // The negated nearest and the furthest depth left to peel, and the
+    // front layers blended so far, written and read by turns in the passes,
+    // and the back layer of the pass, only used by the dual depth peeling.
+    std::array<std::shared_ptr<GlTexture>, 2> dual_depth_textures;
+    std::array<std::shared_ptr<GlTexture>, 2> dual_front_textures;
+    std::shared_ptr<GlTexture> dual_back_texture;
+    int dual_depth_peeling_passes;
+    const SceneOptions options;
     std::set<std::shared_ptr<Visual>> visuals;
 
 public:
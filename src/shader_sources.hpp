@@ -14,6 +14,14 @@ const GlShaderSource &circle_fragment_shader_source();
 
 const GlShaderSource &depth_peeling_fragment_shader_source();
 
+const GlShaderSource &weighted_blended_composite_fragment_shader_source();
+const GlShaderSource &
+    weighted_blended_composite_multisampled_fragment_shader_source();
+
+const GlShaderSource &a_buffer_fragment_shader_source();
+const GlShaderSource &a_buffer_stub_fragment_shader_source();
+const GlShaderSource &a_buffer_resolve_fragment_shader_source();
+
 const GlShaderSource &linesegments_vertex_shader_source();
 const GlShaderSource &linesegments_geometry_shader_source();
 const GlShaderSource &linesegments_fragment_shader_source();
@@ -25,6 +33,8 @@ const GlShaderSource &lines_fragment_shader_source();
 const GlShaderSource &surface_vertex_shader_source();
 const GlShaderSource &surface_fragment_shader_source();
 
+const GlShaderSource &yuv420p_fragment_shader_source();
+
 int line_cap_to_int(const LineCap cap);
 const GlShaderSource &line_cap_geometry_shader_source();
 }
@@ -0,0 +1,152 @@
+#include <shader_sources.hpp>
+
+namespace elementary_visualizer
+{
+// The layout of the A-buffer, shared by the fragment snippet
+// which stores the fragments and the resolve pass which blends them.
+// The first value of the head buffer counts the stored fragments,
+// and the rest are the last stored node of each pixel, 0xffffffff
+// if there is none. Each node is 32 bytes.
+static const char *const a_buffer_layout = R"(
+
+struct ABufferNode
+{
+    vec4 color;
+    float depth;
+    uint coverage;
+    uint next;
+};
+
+layout(binding = 3, std430) coherent buffer a_buffer_head_layout
+{
+    uint a_buffer_node_count;
+    uint a_buffer_heads[];
+};
+
+layout(binding = 4, std430) coherent buffer a_buffer_node_layout
+{
+    ABufferNode a_buffer_nodes[];
+};
+
+const uint a_buffer_end = 0xffffffffu;
+
+)";
+
+const GlShaderSource &a_buffer_fragment_shader_source()
+{
+    static GlShaderSource source(
+        GL_FRAGMENT_SHADER,
+        std::string(SHADER_HEADER) + a_buffer_layout +
+            R"(
+
+uniform uvec2 scene_size;
+uniform int a_buffer_node_capacity;
+
+// The fragment is put in front of the list of its pixel. Fragments
+// which do not fit in the node buffer are still counted, so that
+// the buffer can be grown to fit them.
+void a_buffer_output(vec4 color)
+{
+    uint node = atomicAdd(a_buffer_node_count, 1u);
+    if (node >= uint(a_buffer_node_capacity))
+        return;
+
+    uint pixel = uint(gl_FragCoord.y) * scene_size.x + uint(gl_FragCoord.x);
+    a_buffer_nodes[node].color = color;
+    a_buffer_nodes[node].depth = gl_FragCoord.z;
+    a_buffer_nodes[node].coverage = uint(gl_SampleMaskIn[0]);
+    a_buffer_nodes[node].next = atomicExchange(a_buffer_heads[pixel], node);
+}
+
+)"
+    );
+    return source;
+}
+
+// Linked into the visual programs of the other transparency modes
+// instead, so that they have no buffer writes, which would keep
+// their fragments from being depth tested before they are shaded.
+const GlShaderSource &a_buffer_stub_fragment_shader_source()
+{
+    static GlShaderSource source(
+        GL_FRAGMENT_SHADER,
+        std::string(SHADER_HEADER
+                    R"(
+
+void a_buffer_output(vec4 color)
+{
+}
+
+)")
+    );
+    return source;
+}
+
+const GlShaderSource &a_buffer_resolve_fragment_shader_source()
+{
+    static GlShaderSource source(
+        GL_FRAGMENT_SHADER,
+        std::string(SHADER_HEADER) + a_buffer_layout +
+            R"(
+
+// At most this many fragments of a pixel are blended,
+// the nearest ones.
+const int max_fragment_count = 32;
+
+uniform uvec2 scene_size;
+uniform bool multisampled;
+
+layout (location = 0) out vec4 color_out;
+
+void main()
+{
+    // With multisampling, this runs for each sample,
+    // and only the fragments which cover the sample are blended.
+    uint sample_mask = multisampled ? (1u << gl_SampleID) : 0xffffffffu;
+
+    vec4 colors[max_fragment_count];
+    float depths[max_fragment_count];
+    int fragment_count = 0;
+
+    // The fragments are sorted from front to back by insertion,
+    // dropping the furthest one when there are too many.
+    uint pixel = uint(gl_FragCoord.y) * scene_size.x + uint(gl_FragCoord.x);
+    for (uint node = a_buffer_heads[pixel]; node != a_buffer_end; node = a_buffer_nodes[node].next)
+    {
+        if ((a_buffer_nodes[node].coverage & sample_mask) == 0u)
+            continue;
+
+        float depth = a_buffer_nodes[node].depth;
+        if (fragment_count == max_fragment_count && depth >= depths[fragment_count - 1])
+            continue;
+
+        int i = min(fragment_count, max_fragment_count - 1);
+        while (i > 0 && depths[i - 1] > depth)
+        {
+            colors[i] = colors[i - 1];
+            depths[i] = depths[i - 1];
+            --i;
+        }
+        colors[i] = a_buffer_nodes[node].color;
+        depths[i] = depth;
+        fragment_count = min(fragment_count + 1, max_fragment_count);
+    }
+
+    // The fragments are blended back to front, the same way
+    // as the depth peeling layers. The result is blended over
+    // the background with its alpha, which gives the same color.
+    vec3 color = vec3(0.0f);
+    float alpha = 0.0f;
+    for (int i = fragment_count - 1; i >= 0; --i)
+    {
+        color = colors[i].rgb * colors[i].a + color * (1.0f - colors[i].a);
+        alpha = colors[i].a + alpha * (1.0f - colors[i].a);
+    }
+    color_out = vec4(alpha > 0.0f ? color / alpha : vec3(0.0f), alpha);
+}
+
+)"
+    );
+    return source;
+}
+}
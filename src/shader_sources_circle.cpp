@@ -34,15 +34,14 @@ const GlShaderSource &circle_fragment_shader_source()
 
 uniform vec4 color;
 
-layout (location = 0) out vec4 color_out;
-
 void depth_peeling_discard();
+void transparency_output(vec4 color);
 
 void main()
 {
     depth_peeling_discard();
 
-    color_out = color;
+    transparency_output(color);
 }
 
 )")
@@ -9,21 +9,38 @@ const GlShaderSource &depth_peeling_fragment_shader_source()
         std::string(SHADER_HEADER
                     R"(
 
+// The same values as the TransparencyMode.
+const int transparency_mode_depth_peeling = 0;
+const int transparency_mode_weighted_blended = 1;
+const int transparency_mode_a_buffer = 2;
+const int transparency_mode_dual_depth_peeling = 3;
+
+uniform int transparency_mode;
 uniform bool depth_peeling_first_pass;
+uniform bool depth_peeling_premultiplied_alpha;
+uniform float depth_peeling_depth_epsilon;
 uniform bool depth_peeling_multisampled;
 uniform sampler2D depth_peeling_texture_slot;
 uniform sampler2DMS depth_peeling_texture_slot_multisampled;
+uniform sampler2D dual_depth_peeling_front_texture_slot;
+uniform sampler2DMS dual_depth_peeling_front_texture_slot_multisampled;
 uniform uvec2 scene_size;
 
+layout (location = 0) out vec4 color_out;
+// Only used by the weighted blended transparency
+// and the dual depth peeling.
+layout (location = 1) out vec4 color_out_1;
+layout (location = 2) out vec4 color_out_2;
+
 void discard_if_close_fragment(float peeled_depth)
 {
-    if (gl_FragCoord.z <= peeled_depth)
+    if (gl_FragCoord.z <= peeled_depth + depth_peeling_depth_epsilon)
         discard;
 }
 
 void depth_peeling_discard()
 {
-    if (!depth_peeling_first_pass)
+    if (!depth_peeling_first_pass && transparency_mode == transparency_mode_depth_peeling)
     {
         if (depth_peeling_multisampled)
         {
@@ -45,6 +62,107 @@ void depth_peeling_discard()
     }
 }
 
+// Weighted blended order-independent transparency, see
+// Weighted Blended Order-Independent Transparency,
+// Morgan McGuire and Louis Bavoil,
+// <https://jcgt.org/published/0002/02/09/>.
+// The fragment is added to the accumulation with a weight which
+// favors near and opaque fragments, and the revealage is multiplied
+// by its transparency.
+void weighted_blended_output(vec4 color)
+{
+    float weight = clamp(
+        pow(min(1.0f, color.a * 10.0f) + 0.01f, 3.0f) * 1e8f * pow(1.0f - gl_FragCoord.z * 0.9f, 3.0f),
+        1e-2f,
+        3e3f
+    );
+    color_out = vec4(color.rgb * color.a, color.a) * weight;
+    color_out_1 = vec4(color.a);
+}
+
+// Reads the texel of the fragment from a texture of the previous
+// dual depth peeling pass. The passes are shaded for each sample
+// when multisampled, so the sample mask holds only the current sample.
+vec4 dual_depth_peeling_fetch(sampler2D texture_slot, sampler2DMS texture_slot_multisampled)
+{
+    if (depth_peeling_multisampled)
+        return texelFetch(texture_slot_multisampled, ivec2(gl_FragCoord.xy), findLSB(gl_SampleMaskIn[0]));
+    else
+        return texelFetch(texture_slot, ivec2(gl_FragCoord.xy), 0);
+}
+
+// Dual depth peeling, see
+// Order Independent Transparency with Dual Depth Peeling,
+// Louis Bavoil and Kevin Myers,
+// <https://developer.download.nvidia.com/SDK/10/opengl/src/dual_depth_peeling/doc/DualDepthPeeling.pdf>.
+// Each pass peels the nearest and the furthest layer at once.
+// Every output is blended with the maximum: the first one holds
+// the negated nearest and the furthest depth left to peel, the second
+// one the front layers blended front to back, and the third one
+// the back layer of the pass.
+void dual_depth_peeling_output(vec4 color)
+{
+    float depth = gl_FragCoord.z;
+    if (depth_peeling_first_pass)
+    {
+        color_out = vec4(-depth, depth, 0.0f, 0.0f);
+        color_out_1 = vec4(0.0f);
+        return;
+    }
+
+    vec2 peeled_depth = dual_depth_peeling_fetch(
+        depth_peeling_texture_slot, depth_peeling_texture_slot_multisampled
+    ).rg;
+    vec4 front = dual_depth_peeling_fetch(
+        dual_depth_peeling_front_texture_slot, dual_depth_peeling_front_texture_slot_multisampled
+    );
+    float nearest_depth = -peeled_depth.r;
+    float furthest_depth = peeled_depth.g;
+
+    // The front layers can only grow, so they are passed through.
+    color_out = vec4(-1.0f, -1.0f, 0.0f, 0.0f);
+    color_out_1 = front;
+    color_out_2 = vec4(0.0f);
+
+    // Already peeled away in a previous pass.
+    if (depth < nearest_depth || depth > furthest_depth)
+        return;
+
+    // Left for the next passes.
+    if (depth > nearest_depth && depth < furthest_depth)
+    {
+        color_out.rg = vec2(-depth, depth);
+        return;
+    }
+
+    if (depth == nearest_depth)
+    {
+        color_out_1.rgb += color.rgb * color.a * (1.0f - front.a);
+        color_out_1.a = 1.0f - (1.0f - front.a) * (1.0f - color.a);
+    }
+    else
+        color_out_2 = color;
+}
+
+void a_buffer_output(vec4 color);
+
+// Every visual writes its fragment color through this,
+// so that the fragment is stored the way the transparency mode
+// of the scene needs it.
+void transparency_output(vec4 color)
+{
+    if (transparency_mode == transparency_mode_weighted_blended)
+        weighted_blended_output(color);
+    else if (transparency_mode == transparency_mode_a_buffer)
+        a_buffer_output(color);
+    else if (transparency_mode == transparency_mode_dual_depth_peeling)
+        dual_depth_peeling_output(color);
+    else if (depth_peeling_premultiplied_alpha)
+        color_out = vec4(color.rgb * color.a, color.a);
+    else
+        color_out = color;
+}
+
 )")
     );
     return source;
@@ -140,14 +140,13 @@ const GlShaderSource &linesegments_fragment_shader_source()
 
 layout (location = 0) in vec4 color_in;
 
-layout (location = 0) out vec4 color_out;
-
 void depth_peeling_discard();
+void transparency_output(vec4 color);
 
 void main()
 {
     depth_peeling_discard();
-    color_out = color_in;
+    transparency_output(color_in);
 }
 
 )")
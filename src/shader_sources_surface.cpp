@@ -96,9 +96,8 @@ layout (location = 0) in vec3 position_in;
 layout (location = 1) in vec4 color_in;
 layout (location = 2) in vec3 normal_in;
 
-layout (location = 0) out vec4 color_out;
-
 void depth_peeling_discard();
+void transparency_output(vec4 color);
 
 void main()
 {
@@ -124,7 +123,7 @@ void main()
     float specular_magnitude = pow(abs(dot(eye_direction, reflection_direction)), shininess);
     vec3 specular = specular_magnitude * specular_color;
 
-    color_out = vec4((ambient_color + diffuse + specular) * color_in.rgb, color_in.a);
+    transparency_output(vec4((ambient_color + diffuse + specular) * color_in.rgb, color_in.a));
 }
 
 )")
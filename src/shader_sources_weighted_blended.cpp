@@ -0,0 +1,63 @@
+#include <shader_sources.hpp>
+
+namespace elementary_visualizer
+{
+const GlShaderSource &weighted_blended_composite_fragment_shader_source()
+{
+    static GlShaderSource source(
+        GL_FRAGMENT_SHADER,
+        std::string(SHADER_HEADER
+                    R"(
+
+uniform sampler2D accumulation_texture_slot;
+uniform sampler2D revealage_texture_slot;
+
+layout (location = 0) in vec2 texture_coordinate_in;
+
+layout (location = 0) out vec4 color_out;
+
+void main()
+{
+    vec4 accumulation = texture(accumulation_texture_slot, texture_coordinate_in);
+    float revealage = texture(revealage_texture_slot, texture_coordinate_in).r;
+    // The weighted average color of the fragments, which covers
+    // everything but the revealed part of the background.
+    color_out = vec4(accumulation.rgb / max(accumulation.a, 1e-5f), 1.0f - revealage);
+}
+
+)")
+    );
+    return source;
+}
+
+const GlShaderSource &
+    weighted_blended_composite_multisampled_fragment_shader_source()
+{
+    static GlShaderSource source(
+        GL_FRAGMENT_SHADER,
+        std::string(SHADER_HEADER
+                    R"(
+
+uniform uvec2 scene_size;
+uniform sampler2DMS accumulation_texture_slot;
+uniform sampler2DMS revealage_texture_slot;
+
+layout (location = 0) in vec2 texture_coordinate_in;
+
+layout (location = 0) out vec4 color_out;
+
+void main()
+{
+    ivec2 coordinate = ivec2(texture_coordinate_in * vec2(scene_size));
+    vec4 accumulation = texelFetch(accumulation_texture_slot, coordinate, gl_SampleID);
+    float revealage = texelFetch(revealage_texture_slot, coordinate, gl_SampleID).r;
+    // The weighted average color of the fragments, which covers
+    // everything but the revealed part of the background.
+    color_out = vec4(accumulation.rgb / max(accumulation.a, 1e-5f), 1.0f - revealage);
+}
+
+)")
+    );
+    return source;
+}
+}
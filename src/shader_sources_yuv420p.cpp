@@ -0,0 +1,45 @@
+#include <shader_sources.hpp>
+
+namespace elementary_visualizer
+{
+const GlShaderSource &yuv420p_fragment_shader_source()
+{
+    static GlShaderSource source(
+        GL_FRAGMENT_SHADER,
+        std::string(SHADER_HEADER
+                    R"(
+
+// 0 for the Y (luma) plane, 1 for the U (Cb) plane, 2 for the V (Cr) plane.
+uniform int plane;
+uniform sampler2D texture_slot;
+
+layout (location = 0) in vec2 texture_coordinate_in;
+
+layout (location = 0) out vec4 color_out;
+
+void main()
+{
+    // The U and V planes are rendered in half resolution, but the scene
+    // is placed by the render mode at any scale, so each fragment
+    // is only the linear filtering of the scene texels around it,
+    // not necessarily the average of the four luma samples it covers.
+    vec3 rgb = clamp(texture(texture_slot, texture_coordinate_in).rgb, 0.0f, 1.0f);
+
+    // ITU-R BT.601 limited range conversion,
+    // which is the same as the default in swscale.
+    float value;
+    if (plane == 0)
+        value = 16.0f + dot(vec3(65.481f, 128.553f, 24.966f), rgb);
+    else if (plane == 1)
+        value = 128.0f + dot(vec3(-37.797f, -74.203f, 112.0f), rgb);
+    else
+        value = 128.0f + dot(vec3(112.0f, -93.786f, -18.214f), rgb);
+
+    color_out = vec4(value / 255.0f, 0.0f, 0.0f, 1.0f);
+}
+
+)")
+    );
+    return source;
+}
+}
@@ -0,0 +1,197 @@
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <new>
+#include <shared_frame_ring_producer.hpp>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+namespace elementary_visualizer
+{
+// Slots and frames are aligned, so that they can be copied
+// (and read by the consumer) with wide loads and stores.
+static const size_t shared_frame_ring_alignment = 64;
+
+static size_t align_up(const size_t size)
+{
+    return (size + shared_frame_ring_alignment - 1) /
+           shared_frame_ring_alignment * shared_frame_ring_alignment;
+}
+
+Expected<std::shared_ptr<SharedFrameRingProducer>, Error>
+    SharedFrameRingProducer::create(
+        const std::string &name,
+        const unsigned int width,
+        const unsigned int height,
+        const unsigned int slot_count,
+        const EncodingQueuePolicy policy,
+        const std::chrono::milliseconds timeout
+    )
+{
+    if (width == 0 || height == 0 || slot_count == 0)
+        return Unexpected<Error>(Error());
+
+    const size_t header_size = align_up(sizeof(SharedFrameRingHeader));
+    const size_t frame_offset = align_up(sizeof(SharedFrameSlotHeader));
+    const size_t frame_size = static_cast<size_t>(4) * width * height;
+    const size_t slot_size = align_up(frame_offset + frame_size);
+    const size_t memory_size = header_size + slot_count * slot_size;
+
+    // An existing shared memory of the same name is not reused,
+    // because a consumer might still be reading it.
+    const int file_descriptor =
+        shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (file_descriptor < 0)
+        return Unexpected<Error>(Error());
+
+    if (ftruncate(file_descriptor, static_cast<off_t>(memory_size)) < 0)
+    {
+        close(file_descriptor);
+        shm_unlink(name.c_str());
+        return Unexpected<Error>(Error());
+    }
+
+    void *memory = mmap(
+        nullptr,
+        memory_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        file_descriptor,
+        0
+    );
+    // The mapping keeps the shared memory alive.
+    close(file_descriptor);
+    if (memory == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return Unexpected<Error>(Error());
+    }
+
+    std::shared_ptr<SharedFrameRingProducer> ring(
+        new SharedFrameRingProducer(
+            name, memory, memory_size, policy, timeout
+        )
+    );
+
+    SharedFrameRingHeader *header = ring->header;
+    header->width = width;
+    header->height = height;
+    header->format = SharedFrameFormat::rgba8;
+    header->slot_count = slot_count;
+    header->slots_offset = header_size;
+    header->slot_size = slot_size;
+    header->frame_offset = frame_offset;
+    header->frame_size = frame_size;
+    header->write_index.store(0, std::memory_order_relaxed);
+    header->read_index.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    header->consumer_pid.store(0, std::memory_order_relaxed);
+    header->version = shared_frame_ring_version;
+    // The magic is released last, so a consumer which acquires it
+    // sees the rest of the header as well.
+    header->magic.store(shared_frame_ring_magic, std::memory_order_release);
+
+    return ring;
+}
+
+Expected<uint8_t *, Error> SharedFrameRingProducer::acquire_frame()
+{
+    if (this->failed)
+        return Unexpected<Error>(Error());
+
+    const uint64_t write_index =
+        this->header->write_index.load(std::memory_order_relaxed);
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + this->timeout;
+
+    // The read index is acquired, so the consumer is done with the slot
+    // before it is overwritten.
+    while (write_index - this->header->read_index.load(
+                             std::memory_order_acquire
+                         ) >=
+           this->header->slot_count)
+    {
+        if (this->policy == EncodingQueuePolicy::drop)
+        {
+            this->skip_frame();
+            return nullptr;
+        }
+        // Neither a dead consumer nor one which never attaches
+        // can hang the rendering.
+        if (this->is_consumer_gone() ||
+            (this->timeout.count() > 0 &&
+             std::chrono::steady_clock::now() >= deadline))
+        {
+            this->failed = true;
+            return Unexpected<Error>(Error());
+        }
+        // Sleep instead of spinning, a frame takes milliseconds anyway.
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    uint8_t *slot = this->slot(write_index);
+    reinterpret_cast<SharedFrameSlotHeader *>(slot)->sequence =
+        this->sequence;
+    return slot + this->header->frame_offset;
+}
+
+void SharedFrameRingProducer::publish_frame()
+{
+    ++this->sequence;
+    // The write index is released, so the consumer which sees it
+    // sees the frame as well.
+    this->header->write_index.fetch_add(1, std::memory_order_release);
+}
+
+void SharedFrameRingProducer::skip_frame()
+{
+    ++this->sequence;
+}
+
+size_t SharedFrameRingProducer::linesize() const
+{
+    return static_cast<size_t>(4) * this->header->width;
+}
+
+SharedFrameRingProducer::~SharedFrameRingProducer()
+{
+    this->header->closed.store(1, std::memory_order_release);
+    munmap(this->memory, this->memory_size);
+    // The consumers which have mapped the memory can still read it.
+    shm_unlink(this->name.c_str());
+}
+
+SharedFrameRingProducer::SharedFrameRingProducer(
+    const std::string &name,
+    void *memory,
+    const size_t memory_size,
+    const EncodingQueuePolicy policy,
+    const std::chrono::milliseconds timeout
+)
+    : name(name),
+      memory(memory),
+      memory_size(memory_size),
+      header(new (memory) SharedFrameRingHeader()),
+      policy(policy),
+      timeout(timeout),
+      sequence(0),
+      failed(false)
+{}
+
+uint8_t *SharedFrameRingProducer::slot(const uint64_t index)
+{
+    uint8_t *slots =
+        static_cast<uint8_t *>(this->memory) + this->header->slots_offset;
+    return slots + (index % this->header->slot_count) * this->header->slot_size;
+}
+
+bool SharedFrameRingProducer::is_consumer_gone() const
+{
+    const pid_t consumer_pid = static_cast<pid_t>(
+        this->header->consumer_pid.load(std::memory_order_relaxed)
+    );
+    // Signal 0 only checks whether the process exists.
+    return consumer_pid > 0 && kill(consumer_pid, 0) != 0 && errno == ESRCH;
+}
+}
@@ -0,0 +1,81 @@
+#ifndef ELEMENTARY_VISUALIZER_SHARED_FRAME_RING_PRODUCER_HPP
+#define ELEMENTARY_VISUALIZER_SHARED_FRAME_RING_PRODUCER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <elementary_visualizer/elementary_visualizer.hpp>
+#include <elementary_visualizer/shared_frame_ring.hpp>
+#include <memory>
+#include <string>
+
+namespace elementary_visualizer
+{
+// Producer side of the shared memory ring of frames, see
+// elementary_visualizer/shared_frame_ring.hpp for the layout.
+// The shared memory is created by the producer,
+// and it is unlinked when the producer is destroyed.
+class SharedFrameRingProducer
+{
+public:
+
+    static Expected<std::shared_ptr<SharedFrameRingProducer>, Error> create(
+        const std::string &name,
+        const unsigned int width,
+        const unsigned int height,
+        const unsigned int slot_count,
+        const EncodingQueuePolicy policy,
+        const std::chrono::milliseconds timeout
+    );
+
+    // Returns the frame of the next free slot, or nullptr if the frame
+    // should be dropped. With the block policy, this waits for
+    // the consumer to release a slot, and it fails if the consumer
+    // process is gone, or the slot is not released within the timeout
+    // (unless it is 0). After a failure, every later call fails.
+    Expected<uint8_t *, Error> acquire_frame();
+    // Publishes the frame returned by `acquire_frame`.
+    void publish_frame();
+    // Counts a frame which is not published, so the sequence numbers
+    // of the published frames show the gap.
+    void skip_frame();
+
+    // Bytes in a row of a frame.
+    size_t linesize() const;
+
+    ~SharedFrameRingProducer();
+
+    SharedFrameRingProducer(SharedFrameRingProducer &&other) = delete;
+    SharedFrameRingProducer &
+        operator=(SharedFrameRingProducer &&other) = delete;
+    SharedFrameRingProducer(const SharedFrameRingProducer &) = delete;
+    SharedFrameRingProducer &
+        operator=(const SharedFrameRingProducer &) = delete;
+
+private:
+
+    SharedFrameRingProducer(
+        const std::string &name,
+        void *memory,
+        const size_t memory_size,
+        const EncodingQueuePolicy policy,
+        const std::chrono::milliseconds timeout
+    );
+
+    uint8_t *slot(const uint64_t index);
+    // Whether the attached consumer process has exited.
+    bool is_consumer_gone() const;
+
+    const std::string name;
+    void *memory;
+    const size_t memory_size;
+    SharedFrameRingHeader *header;
+    const EncodingQueuePolicy policy;
+    const std::chrono::milliseconds timeout;
+    // Sequence number of the next rendered frame.
+    uint64_t sequence;
+    // Set once waiting for the consumer has failed.
+    bool failed;
+};
+}
+
+#endif
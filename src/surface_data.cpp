@@ -101,6 +101,15 @@ const std::vector<float> &SurfaceData::get_color_normal_data() const
     return this->color_normal_data;
 }
 
+bool SurfaceData::is_opaque() const
+{
+    for (size_t j = 3; j < this->color_normal_data.size();
+         j += color_normal_stride)
+        if (this->color_normal_data[j] < 1.0f)
+            return false;
+    return true;
+}
+
 std::vector<GLuint> SurfaceData::get_index_data() const
 {
     if (this->u_size < 2)
@@ -1,105 +1,783 @@
+#include <algorithm>
+#include <cstring>
 #include <gl_resources.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <render_mode.hpp>
+#include <thread>
 #include <video.hpp>
 
 namespace elementary_visualizer
 {
 Video::Impl::Impl(
+    std::shared_ptr<Entity> entity,
     const glm::uvec2 size,
-    std::shared_ptr<WrappedAvFrame> frame,
-    std::shared_ptr<WrappedVideoAvStream> stream
+    std::vector<VideoOutputStream> outputs,
+    std::vector<VideoReadback> readbacks,
+    std::vector<std::shared_ptr<GlFramebufferTexture>> planes,
+    const bool yuv420p
 )
-    : size(size), frame(frame), stream(stream)
+    : entity(entity),
+      size(size),
+      outputs(outputs),
+      readbacks(readbacks),
+      next_readback(0),
+      readbacks_in_flight(0),
+      planes(planes),
+      yuv420p(yuv420p),
+      capture_start(std::nullopt),
+      failed(false),
+      finished(false)
 {}
 
-uint8_t to_8_bit(float color)
+Expected<void, Error> Video::Impl::render(
+    std::shared_ptr<const GlTexture> rendered_scene,
+    const RenderMode render_mode
+)
+{
+    if (!rendered_scene || this->finished)
+        return Unexpected<Error>(Error());
+
+    // A real-time frame is timed when it is rendered, and it is not
+    // even read back if every output drops it.
+    std::vector<std::optional<int64_t>> timestamps =
+        this->capture_timestamps();
+    if (std::none_of(
+            timestamps.begin(),
+            timestamps.end(),
+            [](const std::optional<int64_t> &timestamp) {
+                return timestamp.has_value();
+            }
+        ))
+        return this->result();
+
+    // The next slot is always free, because
+    // we never leave more readbacks in flight than the lag.
+    VideoReadback &readback = this->readbacks[this->next_readback];
+
+    this->convert_on_gpu(rendered_scene, render_mode);
+
+    // Queue the copy of the planes into the pixel buffer, this does not
+    // wait for the rendering to finish. The planes are packed right after
+    // each other, the same way as an image with no padding.
+    const GLenum format = this->yuv420p ? GL_RED : GL_RGBA;
+    size_t offset = 0;
+    for (const auto &plane : this->planes)
+    {
+        readback.pixel_buffer->pack_texture(
+            *plane->texture, format, GL_UNSIGNED_BYTE, offset, false
+        );
+        offset += this->plane_linesize(*plane) * plane->texture->get_size().y;
+    }
+
+    Expected<std::shared_ptr<GlFence>, Error> fence =
+        this->entity->create_fence();
+    if (!fence)
+    {
+        this->failed = true;
+        return this->result();
+    }
+    readback.fence = fence.value();
+    readback.timestamps = timestamps;
+
+    this->next_readback = (this->next_readback + 1) % this->readbacks.size();
+    ++this->readbacks_in_flight;
+
+    // Encode the frames which are lagging behind the most; their copies
+    // have been queued frames ago, so these typically do not block.
+    while (this->readbacks_in_flight >= this->readbacks.size())
+        this->encode_oldest_readback();
+
+    return this->result();
+}
+
+Expected<void, Error> Video::Impl::finish()
+{
+    if (this->finished)
+        return this->result();
+    this->finished = true;
+
+    // Encode every frame which is still in flight,
+    // before the stream is flushed and closed.
+    while (this->readbacks_in_flight > 0)
+        this->encode_oldest_readback();
+
+    // Wait for the background encoding of the queued frames,
+    // the streams are flushed only after this.
+    for (VideoOutputStream &output : this->outputs)
+    {
+        if (!output.encoder)
+            continue;
+        if (!output.encoder->get_result())
+            this->failed = true;
+        output.encoder.reset();
+    }
+
+    this->outputs.clear();
+    return this->result();
+}
+
+Expected<void, Error> Video::Impl::result()
 {
-    return std::clamp(int(255 * color), 0, 255);
+    // The encoders keep their first error, so these are polled
+    // on each frame instead of waiting for them.
+    for (const VideoOutputStream &output : this->outputs)
+        if (output.encoder && !output.encoder->get_result())
+            this->failed = true;
+
+    if (this->failed)
+        return Unexpected<Error>(Error());
+    return Expected<void, Error>();
 }
 
-void Video::Impl::render(
-    std::shared_ptr<const GlTexture> rendered_scene, const RenderMode
+void Video::Impl::convert_on_gpu(
+    std::shared_ptr<const GlTexture> rendered_scene,
+    const RenderMode render_mode
 )
 {
-    if (!rendered_scene)
+    this->entity->make_current_context();
+
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    std::shared_ptr<GlShaderProgram> shader_program =
+        this->yuv420p ? this->entity->yuv420p_shader_program
+                      : this->entity->quad_shader_program;
+    shader_program->use(false);
+
+    // The scene is placed the same way as in a window, but flipped,
+    // because the frames start with the top row,
+    // but the textures with the bottom row.
+    const glm::uvec2 scene_size = rendered_scene->get_size();
+    const glm::mat4 flip =
+        glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f));
+    const glm::mat4 model = render_mode_model(scene_size);
+    const glm::mat4 projection =
+        flip * render_mode_projection(render_mode, this->size, scene_size);
+    shader_program->set_uniform("model", model);
+    shader_program->set_uniform("view", glm::mat4(1.0f));
+    shader_program->set_uniform("projection", projection);
+
+    const int texture_slot = 0;
+    glActiveTexture(GL_TEXTURE0 + texture_slot);
+    rendered_scene->bind(false);
+    shader_program->set_uniform("texture_slot", texture_slot);
+
+    for (size_t plane = 0; plane < this->planes.size(); ++plane)
+    {
+        std::shared_ptr<GlFramebufferTexture> framebuffer_texture =
+            this->planes[plane];
+        framebuffer_texture->framebuffer->bind(false);
+
+        const glm::uvec2 plane_size = framebuffer_texture->texture->get_size();
+        glViewport(0, 0, plane_size.x, plane_size.y);
+
+        // The parts of the frame not covered by the scene are black,
+        // which is 16 for the Y plane and 128 for the U and V planes.
+        if (!this->yuv420p)
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        else if (plane == 0)
+            glClearColor(16.0f / 255.0f, 0.0f, 0.0f, 1.0f);
+        else
+            glClearColor(128.0f / 255.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        if (this->yuv420p)
+            shader_program->set_uniform("plane", static_cast<int>(plane));
+
+        this->entity->quad->render(false);
+    }
+}
+
+std::vector<std::optional<int64_t>> Video::Impl::capture_timestamps()
+{
+    const std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (!this->capture_start)
+        this->capture_start = now;
+
+    const int64_t elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - this->capture_start.value()
+        )
+            .count();
+
+    // Each output drops the frame if it falls on its previous frame
+    // in the time base of the output.
+    std::vector<std::optional<int64_t>> timestamps;
+    for (VideoOutputStream &output : this->outputs)
+    {
+        if (!output.capture_time_base)
+        {
+            timestamps.push_back(AV_NOPTS_VALUE);
+            continue;
+        }
+        const int64_t timestamp = av_rescale_q(
+            elapsed,
+            (AVRational){1, 1000000000},
+            output.capture_time_base.value()
+        );
+        if (timestamp <= output.previous_timestamp)
+        {
+            timestamps.push_back(std::nullopt);
+            continue;
+        }
+        output.previous_timestamp = timestamp;
+        timestamps.push_back(timestamp);
+    }
+    return timestamps;
+}
+
+size_t Video::Impl::plane_linesize(const GlFramebufferTexture &plane) const
+{
+    const size_t bytes_per_pixel = this->yuv420p ? 1 : 4;
+    return bytes_per_pixel * plane.texture->get_size().x;
+}
+
+void Video::Impl::encode_oldest_readback()
+{
+    const size_t oldest_readback =
+        (this->next_readback + this->readbacks.size() -
+         this->readbacks_in_flight) %
+        this->readbacks.size();
+    VideoReadback &readback = this->readbacks[oldest_readback];
+    --this->readbacks_in_flight;
+
+    std::shared_ptr<GlFence> fence = readback.fence;
+    readback.fence.reset();
+
+    if (!fence->client_wait())
+    {
+        this->failed = true;
         return;
+    }
 
-    // TODO: implement `RenderMode` correctly instead of
-    // not rendering when there is a size mismatch.
-    if (this->size != rendered_scene->get_size())
+    Expected<const void *, Error> mapped = readback.pixel_buffer->map(false);
+    if (!mapped)
+    {
+        this->failed = true;
         return;
+    }
 
-    std::vector<float> rendered_scene_data(4 * this->size.x * this->size.y);
-    rendered_scene->bind();
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, &rendered_scene_data[0]);
+    // The same readback is copied into the frame of each output,
+    // which then converts and encodes it on its own.
+    for (size_t i = 0; i < this->outputs.size(); ++i)
+    {
+        VideoOutputStream &output = this->outputs[i];
+        if (!readback.timestamps[i])
+            continue;
 
-    AVFrame *av_frame = **(this->frame);
-    const int linesize = av_frame->linesize[0];
-    uint8_t *data = av_frame->data[0];
+        if (output.shared_frame_ring)
+        {
+            Expected<uint8_t *, Error> data =
+                output.shared_frame_ring->acquire_frame();
+            if (!data)
+            {
+                this->failed = true;
+                continue;
+            }
+            if (!data.value())
+                continue;
+            const int linesize =
+                static_cast<int>(output.shared_frame_ring->linesize());
+            uint8_t *destination = data.value();
+            this->copy_readback(mapped.value(), &destination, &linesize);
+            output.shared_frame_ring->publish_frame();
+            continue;
+        }
 
-    for (unsigned int y = 0; y < this->size.y; ++y)
-    {
-        for (unsigned int x = 0; x < this->size.x; ++x)
+        // With the asynchronous encoding, the readback is copied
+        // into a frame from the pool of the encoder.
+        std::shared_ptr<WrappedAvFrame> frame = output.frame;
+        if (output.encoder)
         {
-            uint8_t r =
-                to_8_bit(rendered_scene_data[4 * (this->size.x * y + x) + 0]);
-            uint8_t g =
-                to_8_bit(rendered_scene_data[4 * (this->size.x * y + x) + 1]);
-            uint8_t b =
-                to_8_bit(rendered_scene_data[4 * (this->size.x * y + x) + 2]);
-            const int y_mirrored = (this->size.y - 1) - y;
-            data[(y_mirrored * linesize + 3 * x) + 0] = r;
-            data[(y_mirrored * linesize + 3 * x) + 1] = g;
-            data[(y_mirrored * linesize + 3 * x) + 2] = b;
+            frame = output.encoder->acquire_frame();
+            if (!frame)
+                continue;
         }
+
+        this->copy_readback(
+            mapped.value(), (**frame)->data, (**frame)->linesize
+        );
+        (**frame)->pts = readback.timestamps[i].value();
+
+        if (output.encoder)
+            output.encoder->submit_frame(frame);
+        else if (!output.stream->write_frame(frame))
+            this->failed = true;
     }
 
-    this->stream->write_frame(this->frame);
+    readback.pixel_buffer->unmap(false);
 }
 
-Video::Impl::~Impl(){};
+void Video::Impl::copy_readback(
+    const void *readback_data,
+    uint8_t *const *destinations,
+    const int *linesizes
+)
+{
+    const uint8_t *plane_data = static_cast<const uint8_t *>(readback_data);
 
-Expected<std::shared_ptr<Video>, Error> Video::create(
-    const std::string &filename,
+    for (size_t plane = 0; plane < this->planes.size(); ++plane)
+    {
+        const size_t readback_linesize =
+            this->plane_linesize(*this->planes[plane]);
+        const unsigned int plane_height =
+            this->planes[plane]->texture->get_size().y;
+        const int linesize = linesizes[plane];
+        uint8_t *destination = destinations[plane];
+
+        // The planes are already flipped on the GPU.
+        if (linesize == static_cast<int>(readback_linesize))
+        {
+            std::memcpy(
+                destination, plane_data, readback_linesize * plane_height
+            );
+        }
+        else
+        {
+            for (unsigned int y = 0; y < plane_height; ++y)
+                std::memcpy(
+                    destination + y * linesize,
+                    plane_data + y * readback_linesize,
+                    readback_linesize
+                );
+        }
+
+        plane_data += readback_linesize * plane_height;
+    }
+}
+
+Video::Impl::~Impl()
+{
+    this->finish();
+};
+
+// Creates the format context and the stream of an output,
+// its encoding is created only after the frames are known.
+static Expected<VideoOutputStream, Error> create_output_stream(
+    const VideoOutput &output,
     const glm::uvec2 &size,
-    const unsigned int frame_rate,
-    const int64_t bit_rate,
-    const std::optional<enum AVCodecID> codec_id,
-    const bool intermediate_yuv420p_conversion
+    const unsigned int frame_rate
 )
 {
+    if (output.shared_memory_name)
+    {
+        Expected<std::shared_ptr<SharedFrameRingProducer>, Error>
+            shared_frame_ring = SharedFrameRingProducer::create(
+                output.shared_memory_name.value(),
+                size.x,
+                size.y,
+                output.shared_memory_slot_count,
+                output.shared_memory_policy,
+                std::chrono::milliseconds(output.shared_memory_timeout)
+            );
+        if (!shared_frame_ring)
+            return Unexpected<Error>(Error());
+
+        VideoOutputStream output_stream;
+        output_stream.previous_timestamp = -1;
+        output_stream.shared_frame_ring = shared_frame_ring.value();
+        return output_stream;
+    }
+
+    const VideoOptions &options = output.options;
+
+    // The codec's pixel format is chosen to be the best match for RGB24,
+    // because the alpha of the rendered scene is not encoded.
     const enum AVPixelFormat source_pixel_format = AV_PIX_FMT_RGB24;
 
+    // The chunks are cut by frame count, so they cannot be timed
+    // by a clock.
+    const bool real_time = options.capture_mode == CaptureMode::real_time;
+    if (real_time && options.chunk_size > 0)
+        return Unexpected<Error>(Error());
+    if (real_time && options.capture_time_base == 0)
+        return Unexpected<Error>(Error());
+    const bool constant_frame_rate =
+        options.frame_rate_policy == FrameRatePolicy::constant;
+
+    CodecSettings codec_settings;
+    codec_settings.gop_size = options.gop_size;
+    if (options.max_b_frames)
+        codec_settings.max_b_frames = options.max_b_frames.value();
+    if (options.rate_control == RateControl::constant_quality)
+        codec_settings.constant_quality = options.quality;
+    codec_settings.thread_count = options.codec_thread_count;
+    if (options.chunk_size > 0)
+    {
+        // The chunks are closed groups of pictures only without B-frames,
+        // and they are already encoded in parallel.
+        codec_settings.max_b_frames = 0;
+        codec_settings.thread_count = 1;
+    }
+    if (options.codec_thread_type == CodecThreadType::frame)
+        codec_settings.thread_type = FF_THREAD_FRAME;
+    else if (options.codec_thread_type == CodecThreadType::slice)
+        codec_settings.thread_type = FF_THREAD_SLICE;
+
+    // With the constant frame rate, the frames are timed
+    // in the frame rate units, the same as offline.
+    std::optional<AVRational> capture_time_base;
+    if (real_time && constant_frame_rate)
+    {
+        capture_time_base = (AVRational){1, static_cast<int>(frame_rate)};
+    }
+    else if (real_time)
+    {
+        capture_time_base =
+            (AVRational){1, static_cast<int>(options.capture_time_base)};
+        codec_settings.time_base = capture_time_base;
+    }
+
+    if (options.pixel_format)
+    {
+        codec_settings.pixel_format =
+            av_get_pix_fmt(options.pixel_format.value().c_str());
+        if (codec_settings.pixel_format == AV_PIX_FMT_NONE)
+            return Unexpected<Error>(Error());
+    }
+    // The chunks are converted by swscale, which cannot quantize.
+    if (options.palette_quantization && options.chunk_size == 0)
+        codec_settings.palette = PaletteSettings{
+            options.palette_segment_size, options.palette_sample_size
+        };
+
+    WrappedAvDictionary parameters;
+    if (options.preset)
+        parameters.set("preset", options.preset.value());
+    for (const auto &[key, value] : options.parameters)
+        parameters.set(key, value);
+
+    std::shared_ptr<WrappedAvIoContext> io_context;
+    if (options.output_callback || options.output_memory)
+    {
+        Expected<std::shared_ptr<WrappedAvIoContext>, Error>
+            tmp_io_context =
+                options.output_callback
+                    ? WrappedAvIoContext::create(
+                          options.output_callback, options.output_buffer_size
+                      )
+                    : WrappedAvIoContext::create(
+                          options.output_memory, options.output_buffer_size
+                      );
+        if (!tmp_io_context)
+            return Unexpected<Error>(Error());
+        io_context = tmp_io_context.value();
+    }
+    else if (options.output_file_buffer_size > 0)
+    {
+        // Formats which write their own files (like image sequences)
+        // do not use the output.
+        const AVOutputFormat *output_format = av_guess_format(
+            options.format_name ? options.format_name->c_str() : nullptr,
+            output.file_name.c_str(),
+            nullptr
+        );
+        if (output_format && !(output_format->flags & AVFMT_NOFILE))
+        {
+            Expected<std::shared_ptr<WrappedAvIoContext>, Error>
+                tmp_io_context = WrappedAvIoContext::create(
+                    output.file_name, options.output_file_buffer_size
+                );
+            if (!tmp_io_context)
+                return Unexpected<Error>(Error());
+            io_context = tmp_io_context.value();
+        }
+    }
+
     Expected<std::shared_ptr<WrappedOutputVideoAvFormatContext>, Error>
         format_context = WrappedOutputVideoAvFormatContext::create(
-            filename,
-            std::nullopt,
-            bit_rate,
+            output.file_name,
+            options.format_name,
+            output.bit_rate,
             size.x,
             size.y,
             frame_rate,
             source_pixel_format,
-            WrappedAvDictionary(),
-            codec_id,
-            intermediate_yuv420p_conversion
+            parameters,
+            output.codec_id,
+            output.intermediate_yuv420p_conversion,
+            codec_settings,
+            io_context
         );
     if (!format_context)
         return Unexpected<Error>(Error());
 
     Expected<std::shared_ptr<WrappedVideoAvStream>, Error> stream =
         WrappedVideoAvStream::create_and_open_format_context(
-            format_context.value()
+            format_context.value(), real_time && constant_frame_rate
         );
     if (!stream)
         return Unexpected<Error>(Error());
 
+    VideoOutputStream output_stream;
+    output_stream.format_context = format_context.value();
+    output_stream.stream = stream.value();
+    output_stream.capture_time_base = capture_time_base;
+    output_stream.previous_timestamp = -1;
+    return output_stream;
+}
+
+// Creates the frame and the encoding of an output,
+// which takes frames in the pixel format.
+static Expected<void, Error> create_output_encoding(
+    VideoOutputStream &output_stream,
+    const VideoOptions &options,
+    const enum AVPixelFormat frame_pixel_format,
+    const glm::uvec2 &size
+)
+{
+    if (output_stream.shared_frame_ring)
+        return Expected<void, Error>();
+
+    const bool real_time = options.capture_mode == CaptureMode::real_time;
+
     Expected<std::shared_ptr<WrappedAvFrame>, Error> frame =
-        WrappedAvFrame::create(source_pixel_format, size.x, size.y);
+        WrappedAvFrame::create(frame_pixel_format, size.x, size.y);
     if (!frame)
         return Unexpected<Error>(Error());
+    output_stream.frame = frame.value();
+
+    if (options.chunk_size > 0)
+    {
+        const unsigned int chunk_thread_count =
+            options.chunk_thread_count > 0
+                ? options.chunk_thread_count
+                : std::max(1u, std::thread::hardware_concurrency());
+        Expected<std::shared_ptr<ChunkedVideoEncoder>, Error> tmp_encoder =
+            ChunkedVideoEncoder::create(
+                output_stream.stream,
+                output_stream.format_context,
+                frame_pixel_format,
+                size.x,
+                size.y,
+                options.chunk_size,
+                chunk_thread_count
+            );
+        if (!tmp_encoder)
+            return Unexpected<Error>(Error());
+        output_stream.encoder = tmp_encoder.value();
+    }
+    else if (options.encoding_queue_size > 0 || real_time)
+    {
+        // A real-time capture drops the frames instead of waiting
+        // for the encoding, and the clock keeps the timing right.
+        const unsigned int encoding_queue_size =
+            options.encoding_queue_size > 0 ? options.encoding_queue_size
+                                            : 8;
+        const EncodingQueuePolicy encoding_queue_policy =
+            real_time ? EncodingQueuePolicy::drop
+                      : options.encoding_queue_policy;
+        Expected<std::shared_ptr<VideoEncoder>, Error> tmp_encoder =
+            VideoEncoder::create(
+                output_stream.stream,
+                frame_pixel_format,
+                size.x,
+                size.y,
+                encoding_queue_size,
+                encoding_queue_policy
+            );
+        if (!tmp_encoder)
+            return Unexpected<Error>(Error());
+        output_stream.encoder = tmp_encoder.value();
+    }
+
+    return Expected<void, Error>();
+}
+
+VideoOutput VideoOutput::lossless(
+    const std::string &file_name,
+    const LosslessCodec codec,
+    const VideoOptions &options
+)
+{
+    VideoOutput output;
+    output.file_name = file_name;
+    output.bit_rate = 0;
+    output.intermediate_yuv420p_conversion = false;
+    output.options = options;
+
+    // The pixel formats keep the RGB values without a YUV conversion,
+    // though swscale still repacks the RGBA readback into them.
+    // The codec parameters favor the speed over the compression.
+    // The parameters of the options take precedence.
+    std::string pixel_format;
+    std::map<std::string, std::string> parameters;
+    if (codec == LosslessCodec::utvideo)
+    {
+        output.codec_id = AV_CODEC_ID_UTVIDEO;
+        pixel_format = "gbrp";
+        parameters = {{"pred", "left"}};
+    }
+    else if (codec == LosslessCodec::ffv1)
+    {
+        output.codec_id = AV_CODEC_ID_FFV1;
+        // The packed RGB format of FFV1 on little-endian machines.
+        pixel_format = "bgr0";
+        parameters = {
+            {"level", "3"},
+            {"coder", "0"},
+            {"context", "0"},
+            {"slices", "16"},
+            {"slicecrc", "0"}
+        };
+    }
+    else
+    {
+        output.codec_id = AV_CODEC_ID_RAWVIDEO;
+        pixel_format = "rgb24";
+    }
 
-    std::unique_ptr<Video::Impl> impl(
-        std::make_unique<Impl>(size, frame.value(), stream.value())
-    );
+    if (!output.options.format_name)
+        output.options.format_name = "matroska";
+    if (!output.options.pixel_format)
+        output.options.pixel_format = pixel_format;
+    for (const auto &[key, value] : parameters)
+        output.options.parameters.emplace(key, value);
+    // Every frame is an intra frame, so the capture can be cut anywhere.
+    output.options.gop_size = 1;
+    if (output.options.output_file_buffer_size == 0)
+        output.options.output_file_buffer_size = 8 * 1024 * 1024;
+
+    return output;
+}
+
+VideoOutput VideoOutput::shared_memory(
+    const std::string &name,
+    const unsigned int slot_count,
+    const EncodingQueuePolicy policy
+)
+{
+    VideoOutput output;
+    output.shared_memory_name = name;
+    output.shared_memory_slot_count = slot_count;
+    output.shared_memory_policy = policy;
+    return output;
+}
+
+Expected<std::shared_ptr<Video>, Error> Video::create(
+    const std::string &filename,
+    const glm::uvec2 &size,
+    const unsigned int frame_rate,
+    const int64_t bit_rate,
+    const std::optional<enum AVCodecID> codec_id,
+    const bool intermediate_yuv420p_conversion,
+    const VideoOptions &options
+)
+{
+    VideoOutput output;
+    output.file_name = filename;
+    output.bit_rate = bit_rate;
+    output.codec_id = codec_id;
+    output.intermediate_yuv420p_conversion = intermediate_yuv420p_conversion;
+    output.options = options;
+    return Video::create(std::vector<VideoOutput>{output}, size, frame_rate);
+}
+
+Expected<std::shared_ptr<Video>, Error> Video::create(
+    const std::vector<VideoOutput> &outputs,
+    const glm::uvec2 &size,
+    const unsigned int frame_rate
+)
+{
+    if (outputs.empty())
+        return Unexpected<Error>(Error());
+
+    Expected<std::shared_ptr<Entity>, Error> entity =
+        Entity::ensure_initialized_and_get();
+    if (!entity)
+        return Unexpected<Error>(Error());
+
+    std::vector<VideoOutputStream> output_streams;
+    for (const VideoOutput &output : outputs)
+    {
+        Expected<VideoOutputStream, Error> output_stream =
+            create_output_stream(output, size, frame_rate);
+        if (!output_stream)
+            return Unexpected<Error>(Error());
+        output_streams.push_back(output_stream.value());
+    }
+
+    // If every codec takes YUV420P (or the frames are converted through
+    // YUV420P anyway), then the conversion is done on the GPU,
+    // and a lot less data needs to be read back. Otherwise the rendered
+    // scene is converted to RGBA8 on the GPU, and the rest of the
+    // conversion is done by each stream.
+    const enum AVPixelFormat pixel_format_yuv420p = AV_PIX_FMT_YUV420P;
+    const enum AVPixelFormat pixel_format_rgba = AV_PIX_FMT_RGBA;
+    // The shared memory takes RGBA frames.
+    bool yuv420p = true;
+    for (const VideoOutputStream &output_stream : output_streams)
+    {
+        if (output_stream.shared_frame_ring)
+        {
+            yuv420p = false;
+            continue;
+        }
+        const enum AVPixelFormat codec_pixel_format =
+            static_cast<enum AVPixelFormat>(
+                (**output_stream.stream)->codecpar->format
+            );
+        yuv420p = yuv420p &&
+                  (codec_pixel_format == pixel_format_yuv420p ||
+                   output_stream.format_context
+                       ->is_intermediate_yuv420p_conversion());
+    }
+
+    // The chroma planes are half the size, rounded up the same way as
+    // in the frames, so that with an odd width or height their last
+    // column or row is written too. Each row is copied into the frame
+    // with the linesize of its own plane.
+    std::vector<glm::uvec2> plane_sizes = {size};
+    if (yuv420p)
+        plane_sizes = {size, (size + 1u) / 2u, (size + 1u) / 2u};
+    const GLint plane_internalformat = yuv420p ? GL_R8 : GL_RGBA8;
+    const size_t bytes_per_pixel = yuv420p ? 1 : 4;
+
+    std::vector<std::shared_ptr<GlFramebufferTexture>> planes;
+    size_t readback_size = 0;
+    for (const glm::uvec2 &plane_size : plane_sizes)
+    {
+        Expected<std::shared_ptr<GlFramebufferTexture>, Error> plane =
+            entity.value()->create_framebuffer_texture(
+                plane_size, std::nullopt, plane_internalformat
+            );
+        if (!plane)
+            return Unexpected<Error>(Error());
+        planes.push_back(plane.value());
+        readback_size += bytes_per_pixel * plane_size.x * plane_size.y;
+    }
+
+    const enum AVPixelFormat frame_pixel_format =
+        yuv420p ? pixel_format_yuv420p : pixel_format_rgba;
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        Expected<void, Error> encoding_result = create_output_encoding(
+            output_streams[i], outputs[i].options, frame_pixel_format, size
+        );
+        if (!encoding_result)
+            return Unexpected<Error>(Error());
+    }
+
+    // One slot for the frame which is just rendered, and one for each
+    // frame the encoding lags behind, which is the longest lag
+    // of the outputs.
+    unsigned int readback_lag = 0;
+    for (const VideoOutput &output : outputs)
+        readback_lag = std::max(readback_lag, output.options.readback_lag);
+    std::vector<VideoReadback> readbacks;
+    for (unsigned int i = 0; i < readback_lag + 1; ++i)
+    {
+        Expected<std::shared_ptr<GlPixelBuffer>, Error> pixel_buffer =
+            entity.value()->create_pixel_buffer(readback_size);
+        if (!pixel_buffer)
+            return Unexpected<Error>(Error());
+        readbacks.push_back(VideoReadback(pixel_buffer.value()));
+    }
+
+    std::unique_ptr<Video::Impl> impl(std::make_unique<Impl>(
+        entity.value(), size, output_streams, readbacks, planes, yuv420p
+    ));
 
     return std::shared_ptr<Video>(new Video(std::move(impl)));
 }
@@ -112,12 +790,17 @@ Video &Video::operator=(Video &&other)
     return *this;
 }
 
-void Video::render(
+Expected<void, Error> Video::render(
     std::shared_ptr<const GlTexture> rendered_scene,
     const RenderMode render_mode
 )
 {
-    this->impl->render(rendered_scene, render_mode);
+    return this->impl->render(rendered_scene, render_mode);
+}
+
+Expected<void, Error> Video::finish()
+{
+    return this->impl->finish();
 }
 
 Video::~Video() {}
@@ -2,25 +2,72 @@
 #define ELEMENTARY_VISUALIZER_VIDEO_HPP
 
 #include <av_resources.hpp>
+#include <chrono>
 #include <elementary_visualizer/elementary_visualizer.hpp>
+#include <entity.hpp>
+#include <gl_resources.hpp>
 #include <memory>
+#include <optional>
+#include <shared_frame_ring_producer.hpp>
+#include <vector>
+#include <video_encoder.hpp>
 
 namespace elementary_visualizer
 {
+// A readback of one rendered frame, which is possibly still in flight.
+struct VideoReadback
+{
+    std::shared_ptr<GlPixelBuffer> pixel_buffer;
+    // Signaled when the copy into the pixel buffer has completed.
+    // It is nullptr if there is no readback in flight in this slot.
+    std::shared_ptr<GlFence> fence;
+    // Timestamp of the frame for each output; AV_NOPTS_VALUE if
+    // the output is not a real-time capture, and nullopt if the output
+    // drops the frame.
+    std::vector<std::optional<int64_t>> timestamps;
+    VideoReadback(std::shared_ptr<GlPixelBuffer> pixel_buffer)
+        : pixel_buffer(pixel_buffer), fence(nullptr), timestamps()
+    {}
+};
+
+// One output of a Video, with its own format context and encoding,
+// or with its own shared memory.
+struct VideoOutputStream
+{
+    std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context;
+    std::shared_ptr<WrappedVideoAvStream> stream;
+    // The readbacks are copied into this frame if there is no encoder.
+    std::shared_ptr<WrappedAvFrame> frame;
+    // If not nullptr, the frames are encoded on its background threads,
+    // and the stream must not be used directly.
+    std::shared_ptr<FrameEncoder> encoder;
+    // If set, this is a real-time capture, and the frames are timed
+    // in this time base.
+    std::optional<AVRational> capture_time_base;
+    int64_t previous_timestamp;
+    // If not nullptr, the readbacks are copied into it,
+    // and there is no stream.
+    std::shared_ptr<SharedFrameRingProducer> shared_frame_ring;
+};
+
 class Video::Impl
 {
 public:
 
     Impl(
+        std::shared_ptr<Entity> entity,
         const glm::uvec2 size,
-        std::shared_ptr<WrappedAvFrame> frame,
-        std::shared_ptr<WrappedVideoAvStream> stream
+        std::vector<VideoOutputStream> outputs,
+        std::vector<VideoReadback> readbacks,
+        std::vector<std::shared_ptr<GlFramebufferTexture>> planes,
+        const bool yuv420p
     );
 
-    void render(
+    Expected<void, Error> render(
         std::shared_ptr<const GlTexture> rendered_scene,
         const RenderMode render_mode
     );
+    Expected<void, Error> finish();
 
     ~Impl();
 
@@ -31,9 +78,49 @@ public:
 
 private:
 
+    void convert_on_gpu(
+        std::shared_ptr<const GlTexture> rendered_scene,
+        const RenderMode render_mode
+    );
+    // Returns an error if writing any frame has failed so far.
+    Expected<void, Error> result();
+    std::vector<std::optional<int64_t>> capture_timestamps();
+    size_t plane_linesize(const GlFramebufferTexture &plane) const;
+    void encode_oldest_readback();
+    void copy_readback(
+        const void *readback_data,
+        uint8_t *const *destinations,
+        const int *linesizes
+    );
+
+    std::shared_ptr<Entity> entity;
     glm::uvec2 size;
-    std::shared_ptr<WrappedAvFrame> frame;
-    std::shared_ptr<WrappedVideoAvStream> stream;
+
+    // Every frame is read back once, and then written into each output.
+    std::vector<VideoOutputStream> outputs;
+
+    // Ring of readbacks. The encoding lags behind the rendering by
+    // at most `readbacks.size() - 1` frames.
+    std::vector<VideoReadback> readbacks;
+    size_t next_readback;
+    size_t readbacks_in_flight;
+
+    // The rendered scene is converted on the GPU into these planes,
+    // and only these are read back. These are the Y, U and V planes
+    // of a YUV420P frame if `yuv420p` is set, otherwise the only plane
+    // of an RGBA frame; both in 8 bits per component.
+    std::vector<std::shared_ptr<GlFramebufferTexture>> planes;
+    const bool yuv420p;
+
+    // The real-time captures are timed by a monotonic clock,
+    // which starts at the first frame.
+    std::optional<std::chrono::steady_clock::time_point> capture_start;
+
+    // Set on the first failure of writing a frame, which is then
+    // reported by every later call.
+    bool failed;
+    // Set once the outputs are closed.
+    bool finished;
 };
 }
 
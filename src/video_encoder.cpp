@@ -0,0 +1,407 @@
+#include <cstring>
+#include <video_encoder.hpp>
+
+namespace elementary_visualizer
+{
+Expected<std::shared_ptr<VideoEncoder>, Error> VideoEncoder::create(
+    std::shared_ptr<WrappedVideoAvStream> stream,
+    const enum AVPixelFormat pixel_format,
+    const unsigned int width,
+    const unsigned int height,
+    const unsigned int queue_size,
+    const EncodingQueuePolicy queue_policy
+)
+{
+    if (!stream)
+        return Unexpected<Error>(Error());
+
+    if (queue_size == 0)
+        return Unexpected<Error>(Error());
+
+    // The frames are allocated once, and reused for the whole video.
+    std::deque<std::shared_ptr<WrappedAvFrame>> free_frames;
+    for (unsigned int i = 0; i < queue_size; ++i)
+    {
+        Expected<std::shared_ptr<WrappedAvFrame>, Error> frame =
+            WrappedAvFrame::create(pixel_format, width, height);
+        if (!frame)
+            return Unexpected<Error>(Error());
+        free_frames.push_back(frame.value());
+    }
+
+    return std::shared_ptr<VideoEncoder>(
+        new VideoEncoder(stream, free_frames, queue_policy)
+    );
+}
+
+std::shared_ptr<WrappedAvFrame> VideoEncoder::acquire_frame()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    if (this->queue_policy == EncodingQueuePolicy::block)
+        this->frame_freed.wait(lock, [this] {
+            return !this->free_frames.empty();
+        });
+    else if (this->free_frames.empty())
+        return nullptr;
+
+    std::shared_ptr<WrappedAvFrame> frame = this->free_frames.front();
+    this->free_frames.pop_front();
+    return frame;
+}
+
+void VideoEncoder::submit_frame(std::shared_ptr<WrappedAvFrame> frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->queued_frames.push_back(frame);
+    }
+    this->frame_queued.notify_one();
+}
+
+Expected<void, Error> VideoEncoder::get_result()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->failed)
+        return Unexpected<Error>(Error());
+    return Expected<void, Error>();
+}
+
+VideoEncoder::~VideoEncoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->frame_queued.notify_one();
+    this->thread.join();
+}
+
+VideoEncoder::VideoEncoder(
+    std::shared_ptr<WrappedVideoAvStream> stream,
+    std::deque<std::shared_ptr<WrappedAvFrame>> free_frames,
+    const EncodingQueuePolicy queue_policy
+)
+    : stream(stream),
+      queue_policy(queue_policy),
+      free_frames(free_frames),
+      queued_frames(),
+      stopping(false),
+      failed(false),
+      thread(&VideoEncoder::run, this)
+{}
+
+void VideoEncoder::run()
+{
+    while (true)
+    {
+        std::shared_ptr<WrappedAvFrame> frame;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->frame_queued.wait(lock, [this] {
+                return this->stopping || !this->queued_frames.empty();
+            });
+            // The queue is drained before stopping.
+            if (this->queued_frames.empty())
+                return;
+            frame = this->queued_frames.front();
+            this->queued_frames.pop_front();
+        }
+
+        // The stream copies the frame, so it can be reused right after.
+        Expected<void, Error> write_result = this->stream->write_frame(frame);
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (!write_result)
+                this->failed = true;
+            this->free_frames.push_back(frame);
+        }
+        this->frame_freed.notify_one();
+    }
+}
+
+Expected<std::shared_ptr<ChunkedVideoEncoder>, Error>
+    ChunkedVideoEncoder::create(
+        std::shared_ptr<WrappedVideoAvStream> stream,
+        std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context,
+        const enum AVPixelFormat pixel_format,
+        const unsigned int width,
+        const unsigned int height,
+        const unsigned int chunk_size,
+        const unsigned int thread_count
+    )
+{
+    if (!stream || !format_context)
+        return Unexpected<Error>(Error());
+
+    if (chunk_size == 0 || thread_count == 0)
+        return Unexpected<Error>(Error());
+
+    // Enough frames for every thread to encode a chunk,
+    // while an other chunk is being filled.
+    std::deque<std::shared_ptr<WrappedAvFrame>> free_frames;
+    for (unsigned int i = 0; i < chunk_size * (thread_count + 1); ++i)
+    {
+        Expected<std::shared_ptr<WrappedAvFrame>, Error> frame =
+            WrappedAvFrame::create(pixel_format, width, height);
+        if (!frame)
+            return Unexpected<Error>(Error());
+        free_frames.push_back(frame.value());
+    }
+
+    return std::shared_ptr<ChunkedVideoEncoder>(new ChunkedVideoEncoder(
+        stream, format_context, free_frames, chunk_size, thread_count
+    ));
+}
+
+std::shared_ptr<WrappedAvFrame> ChunkedVideoEncoder::acquire_frame()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    // The encoded packets of a chunk are kept until every chunk before it
+    // is muxed, so the number of chunks in flight is limited as well.
+    this->chunk_finished.wait(
+        lock,
+        [this] {
+            return !this->free_frames.empty() &&
+                   this->chunks_in_flight.size() < this->max_chunks_in_flight;
+        }
+    );
+
+    std::shared_ptr<WrappedAvFrame> frame = this->free_frames.front();
+    this->free_frames.pop_front();
+    return frame;
+}
+
+void ChunkedVideoEncoder::submit_frame(std::shared_ptr<WrappedAvFrame> frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        if (!this->current_chunk)
+        {
+            this->current_chunk = std::make_shared<Chunk>();
+            this->current_chunk->first_frame = this->next_frame;
+            this->current_chunk->encoded = false;
+        }
+        this->current_chunk->frames.push_back(frame);
+        ++this->next_frame;
+
+        if (this->current_chunk->frames.size() < this->chunk_size)
+            return;
+
+        this->queue_current_chunk();
+    }
+    this->chunk_queued.notify_one();
+}
+
+Expected<void, Error> ChunkedVideoEncoder::get_result()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->failed)
+        return Unexpected<Error>(Error());
+    return Expected<void, Error>();
+}
+
+ChunkedVideoEncoder::~ChunkedVideoEncoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        // The last chunk might be shorter.
+        if (this->current_chunk)
+            this->queue_current_chunk();
+        this->stopping = true;
+    }
+    this->chunk_queued.notify_all();
+    for (std::thread &thread : this->threads)
+        thread.join();
+}
+
+ChunkedVideoEncoder::ChunkedVideoEncoder(
+    std::shared_ptr<WrappedVideoAvStream> stream,
+    std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context,
+    std::deque<std::shared_ptr<WrappedAvFrame>> free_frames,
+    const unsigned int chunk_size,
+    const unsigned int thread_count
+)
+    : stream(stream),
+      format_context(format_context),
+      chunk_size(chunk_size),
+      max_chunks_in_flight(2 * thread_count + 1),
+      free_frames(free_frames),
+      current_chunk(nullptr),
+      next_frame(0),
+      queued_chunks(),
+      chunks_in_flight(),
+      stopping(false),
+      failed(false)
+{
+    for (unsigned int i = 0; i < thread_count; ++i)
+        this->threads.push_back(std::thread(&ChunkedVideoEncoder::run, this));
+}
+
+void ChunkedVideoEncoder::run()
+{
+    while (true)
+    {
+        std::shared_ptr<Chunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->chunk_queued.wait(
+                lock,
+                [this] {
+                    return this->stopping || !this->queued_chunks.empty();
+                }
+            );
+            // The queue is drained before stopping.
+            if (this->queued_chunks.empty())
+                return;
+            chunk = this->queued_chunks.front();
+            this->queued_chunks.pop_front();
+        }
+
+        // A chunk which fails to encode is left out of the video
+        // as a whole, instead of muxing a truncated group of pictures,
+        // and the error is reported by the Video.
+        Expected<void, Error> encode_result = this->encode_chunk(*chunk);
+        if (!encode_result)
+            chunk->packets.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (!encode_result)
+                this->failed = true;
+            for (const auto &frame : chunk->frames)
+                this->free_frames.push_back(frame);
+            chunk->frames.clear();
+            chunk->encoded = true;
+        }
+        this->chunk_finished.notify_all();
+
+        this->mux_encoded_chunks();
+    }
+}
+
+Expected<void, Error> ChunkedVideoEncoder::encode_chunk(Chunk &chunk)
+{
+    // A new codec context starts with an intra frame,
+    // and it does not reference any frame of the other chunks.
+    Expected<std::shared_ptr<WrappedAvCodecContext>, Error> codec_context =
+        this->format_context->create_codec_context();
+    if (!codec_context)
+        return Unexpected<Error>(Error());
+    AVCodecContext *av_codec_context = **codec_context.value();
+
+    // Every chunk is muxed with the stream headers of the codec context
+    // of the output, so the global headers of the chunk must be the same.
+    // Without global headers, the headers are in the intra frames.
+    const AVCodecParameters *codec_parameters = (**this->stream)->codecpar;
+    if (av_codec_context->extradata_size != codec_parameters->extradata_size ||
+        (av_codec_context->extradata_size > 0 &&
+         std::memcmp(
+             av_codec_context->extradata,
+             codec_parameters->extradata,
+             av_codec_context->extradata_size
+         ) != 0))
+        return Unexpected<Error>(Error());
+
+    Expected<std::shared_ptr<WrappedAvFrame>, Error> codec_frame =
+        WrappedAvFrame::create(
+            av_codec_context->pix_fmt,
+            av_codec_context->width,
+            av_codec_context->height
+        );
+    if (!codec_frame)
+        return Unexpected<Error>(Error());
+
+    Expected<std::shared_ptr<WrappedSwsContext>, Error> sws_context =
+        WrappedSwsContext::create();
+    if (!sws_context)
+        return Unexpected<Error>(Error());
+
+    Expected<std::shared_ptr<WrappedAvPacket>, Error> packet =
+        WrappedAvPacket::create();
+    if (!packet)
+        return Unexpected<Error>(Error());
+
+    // The last iteration sends no frame, which flushes the codec.
+    for (size_t i = 0; i <= chunk.frames.size(); ++i)
+    {
+        AVFrame *av_frame = nullptr;
+        if (i < chunk.frames.size())
+        {
+            Expected<void, Error> convert_result =
+                codec_frame.value()->convert_and_copy(
+                    *chunk.frames[i], *sws_context.value()
+                );
+            if (!convert_result)
+                return Unexpected<Error>(Error());
+            av_frame = **codec_frame.value();
+            // The timestamps are relative to the start of the chunk.
+            av_frame->pts = i;
+        }
+
+        int result = avcodec_send_frame(av_codec_context, av_frame);
+        if (result < 0)
+            return Unexpected<Error>(Error());
+
+        while (true)
+        {
+            result = avcodec_receive_packet(
+                av_codec_context, **packet.value()
+            );
+            if (result == AVERROR(EAGAIN) || result == AVERROR_EOF)
+                break;
+            else if (result < 0)
+                return Unexpected<Error>(Error());
+
+            Expected<std::shared_ptr<WrappedAvPacket>, Error>
+                encoded_packet = WrappedAvPacket::create();
+            if (!encoded_packet)
+                return Unexpected<Error>(Error());
+            av_packet_move_ref(**encoded_packet.value(), **packet.value());
+            chunk.packets.push_back(encoded_packet.value());
+        }
+    }
+
+    return Expected<void, Error>();
+}
+
+void ChunkedVideoEncoder::queue_current_chunk()
+{
+    this->queued_chunks.push_back(this->current_chunk);
+    this->chunks_in_flight.push_back(this->current_chunk);
+    this->current_chunk.reset();
+}
+
+void ChunkedVideoEncoder::mux_encoded_chunks()
+{
+    std::lock_guard<std::mutex> mux_lock(this->mux_mutex);
+
+    while (true)
+    {
+        std::shared_ptr<Chunk> chunk;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->chunks_in_flight.empty() ||
+                !this->chunks_in_flight.front()->encoded)
+                break;
+            chunk = this->chunks_in_flight.front();
+        }
+
+        bool write_failed = false;
+        for (const auto &packet : chunk->packets)
+            if (!this->stream->write_encoded_packet(packet, chunk->first_frame))
+                write_failed = true;
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (write_failed)
+                this->failed = true;
+            this->chunks_in_flight.pop_front();
+        }
+        this->chunk_finished.notify_all();
+    }
+}
+}
@@ -0,0 +1,174 @@
+#ifndef ELEMENTARY_VISUALIZER_VIDEO_ENCODER_HPP
+#define ELEMENTARY_VISUALIZER_VIDEO_ENCODER_HPP
+
+#include <av_resources.hpp>
+#include <condition_variable>
+#include <deque>
+#include <elementary_visualizer/elementary_visualizer.hpp>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace elementary_visualizer
+{
+// Takes the frames of a Video, and encodes them in the background.
+// After creation, the stream must only be used through the encoder,
+// and the encoder only touches FFmpeg, never OpenGL.
+class FrameEncoder
+{
+public:
+
+    // Returns a frame from the pool which can be filled and submitted,
+    // or nullptr if the frame should be dropped.
+    virtual std::shared_ptr<WrappedAvFrame> acquire_frame() = 0;
+    // Queues a frame returned by `acquire_frame` for encoding.
+    virtual void submit_frame(std::shared_ptr<WrappedAvFrame> frame) = 0;
+    // Returns the first error of the background encoding so far,
+    // which is kept, so every later call returns it as well.
+    virtual Expected<void, Error> get_result() = 0;
+
+    // Encodes every queued frame before returning.
+    virtual ~FrameEncoder() = default;
+};
+
+// Encodes frames one by one on a background thread.
+class VideoEncoder : public FrameEncoder
+{
+public:
+
+    static Expected<std::shared_ptr<VideoEncoder>, Error> create(
+        std::shared_ptr<WrappedVideoAvStream> stream,
+        const enum AVPixelFormat pixel_format,
+        const unsigned int width,
+        const unsigned int height,
+        const unsigned int queue_size,
+        const EncodingQueuePolicy queue_policy
+    );
+
+    // If every frame is queued, this waits for the encoding of a frame
+    // with the block policy, and returns nullptr with the drop policy.
+    std::shared_ptr<WrappedAvFrame> acquire_frame() override;
+    void submit_frame(std::shared_ptr<WrappedAvFrame> frame) override;
+    Expected<void, Error> get_result() override;
+
+    ~VideoEncoder() override;
+
+    VideoEncoder(VideoEncoder &&other) = delete;
+    VideoEncoder &operator=(VideoEncoder &&other) = delete;
+    VideoEncoder(const VideoEncoder &) = delete;
+    VideoEncoder &operator=(const VideoEncoder &) = delete;
+
+private:
+
+    VideoEncoder(
+        std::shared_ptr<WrappedVideoAvStream> stream,
+        std::deque<std::shared_ptr<WrappedAvFrame>> free_frames,
+        const EncodingQueuePolicy queue_policy
+    );
+
+    void run();
+
+    std::shared_ptr<WrappedVideoAvStream> stream;
+    const EncodingQueuePolicy queue_policy;
+
+    std::mutex mutex;
+    // Notified when a frame is queued, or the encoder is stopping.
+    std::condition_variable frame_queued;
+    // Notified when a frame is returned to the pool.
+    std::condition_variable frame_freed;
+    std::deque<std::shared_ptr<WrappedAvFrame>> free_frames;
+    std::deque<std::shared_ptr<WrappedAvFrame>> queued_frames;
+    bool stopping;
+    // Set when writing a frame has failed.
+    bool failed;
+
+    std::thread thread;
+};
+
+// Cuts the frames into chunks, and encodes each chunk with its own
+// codec context on a thread pool. Each chunk starts with an intra frame,
+// and the codec must not use B-frames, so the chunks are closed groups
+// of pictures, which are muxed one after the other in order.
+class ChunkedVideoEncoder : public FrameEncoder
+{
+public:
+
+    static Expected<std::shared_ptr<ChunkedVideoEncoder>, Error> create(
+        std::shared_ptr<WrappedVideoAvStream> stream,
+        std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context,
+        const enum AVPixelFormat pixel_format,
+        const unsigned int width,
+        const unsigned int height,
+        const unsigned int chunk_size,
+        const unsigned int thread_count
+    );
+
+    // Waits if too many chunks are waiting for encoding or muxing.
+    std::shared_ptr<WrappedAvFrame> acquire_frame() override;
+    void submit_frame(std::shared_ptr<WrappedAvFrame> frame) override;
+    Expected<void, Error> get_result() override;
+
+    ~ChunkedVideoEncoder() override;
+
+    ChunkedVideoEncoder(ChunkedVideoEncoder &&other) = delete;
+    ChunkedVideoEncoder &operator=(ChunkedVideoEncoder &&other) = delete;
+    ChunkedVideoEncoder(const ChunkedVideoEncoder &) = delete;
+    ChunkedVideoEncoder &operator=(const ChunkedVideoEncoder &) = delete;
+
+private:
+
+    struct Chunk
+    {
+        // Index of the first frame of the chunk in the whole video.
+        int64_t first_frame;
+        std::vector<std::shared_ptr<WrappedAvFrame>> frames;
+        std::vector<std::shared_ptr<WrappedAvPacket>> packets;
+        bool encoded;
+    };
+
+    ChunkedVideoEncoder(
+        std::shared_ptr<WrappedVideoAvStream> stream,
+        std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context,
+        std::deque<std::shared_ptr<WrappedAvFrame>> free_frames,
+        const unsigned int chunk_size,
+        const unsigned int thread_count
+    );
+
+    void run();
+    Expected<void, Error> encode_chunk(Chunk &chunk);
+    void queue_current_chunk();
+    void mux_encoded_chunks();
+
+    std::shared_ptr<WrappedVideoAvStream> stream;
+    std::shared_ptr<WrappedOutputVideoAvFormatContext> format_context;
+    const unsigned int chunk_size;
+    // Number of chunks which can be encoded or waiting for muxing at once.
+    const size_t max_chunks_in_flight;
+
+    std::mutex mutex;
+    // Notified when a chunk is queued, or the encoder is stopping.
+    std::condition_variable chunk_queued;
+    // Notified when frames are returned to the pool, or a chunk is muxed.
+    std::condition_variable chunk_finished;
+    std::deque<std::shared_ptr<WrappedAvFrame>> free_frames;
+    // The chunk which is being filled by the submitted frames.
+    std::shared_ptr<Chunk> current_chunk;
+    int64_t next_frame;
+    // Chunks waiting for a thread to encode them.
+    std::deque<std::shared_ptr<Chunk>> queued_chunks;
+    // Chunks which are queued, encoding or encoded,
+    // in the order of muxing.
+    std::deque<std::shared_ptr<Chunk>> chunks_in_flight;
+    bool stopping;
+    // Set when muxing a packet has failed.
+    bool failed;
+
+    // Only one thread muxes at a time, the others carry on encoding.
+    std::mutex mux_mutex;
+
+    std::vector<std::thread> threads;
+};
+}
+
+#endif
@@ -23,13 +23,37 @@ glm::mat4 make_projection(
     return projection;
 }
 
+bool is_opaque_color(const glm::vec4 &color)
+{
+    return color.a >= 1.0f;
+}
+
+bool is_opaque_vertices(const std::vector<Vertex> &vertices)
+{
+    for (const auto &vertex : vertices)
+        if (!is_opaque_color(vertex.color))
+            return false;
+    return true;
+}
+
+bool is_opaque_linesegments(const std::vector<Linesegment> &linesegments)
+{
+    for (const auto &linesegment : linesegments)
+        if (!is_opaque_color(linesegment.start.color) ||
+            !is_opaque_color(linesegment.end.color))
+            return false;
+    return true;
+}
+
 LinesegmentsVisual::Impl::Impl(
     std::shared_ptr<Entity> entity,
     std::shared_ptr<GlLinesegments> linesegments,
-    const LineCap cap
+    const LineCap cap,
+    const bool opaque
 )
     : entity(entity),
       linesegments(linesegments),
+      opaque(opaque),
       cap(cap),
       model(1.0f),
       view(1.0f),
@@ -42,7 +66,9 @@ void LinesegmentsVisual::Impl::render(
 ) const
 {
     std::shared_ptr<GlShaderProgram> shader_program =
-        this->entity->linesegments_shader_program;
+        depth_peeling_data.transparency_mode == TransparencyMode::a_buffer
+            ? this->entity->linesegments_a_buffer_shader_program
+            : this->entity->linesegments_shader_program;
     shader_program->use();
 
     depth_peeling_set_uniforms(shader_program, depth_peeling_data);
@@ -63,11 +89,17 @@ void LinesegmentsVisual::Impl::render(
     this->linesegments->render(false);
 }
 
+bool LinesegmentsVisual::Impl::is_opaque() const
+{
+    return this->opaque;
+}
+
 void LinesegmentsVisual::Impl::set_linesegments_data(
     const std::vector<Linesegment> &linesegments_data
 )
 {
     this->linesegments->set_linesegments_data(linesegments_data);
+    this->opaque = is_opaque_linesegments(linesegments_data);
 }
 
 LinesegmentsVisual::Impl::~Impl(){};
@@ -87,7 +119,10 @@ Expected<std::shared_ptr<LinesegmentsVisual>, Error> LinesegmentsVisual::create(
 
             std::unique_ptr<LinesegmentsVisual::Impl> impl(
                 std::make_unique<LinesegmentsVisual::Impl>(
-                    entity, linesegments.value(), cap
+                    entity,
+                    linesegments.value(),
+                    cap,
+                    is_opaque_linesegments(linesegments_data)
                 )
             );
             return std::shared_ptr<LinesegmentsVisual>(
@@ -122,6 +157,11 @@ void LinesegmentsVisual::render(
     this->impl->render(scene_size, depth_peeling_data);
 }
 
+bool LinesegmentsVisual::is_opaque() const
+{
+    return this->impl->is_opaque();
+}
+
 void LinesegmentsVisual::set_model(const glm::mat4 &model)
 {
     this->impl->model = model;
@@ -168,10 +208,12 @@ LinesVisual::Impl::Impl(
     std::shared_ptr<Entity> entity,
     std::shared_ptr<GlLines> lines,
     const float width,
-    const LineCap cap
+    const LineCap cap,
+    const bool opaque
 )
     : entity(entity),
       lines(lines),
+      opaque(opaque),
       width(width),
       cap(cap),
       model(1.0f),
@@ -185,7 +227,9 @@ void LinesVisual::Impl::render(
 ) const
 {
     std::shared_ptr<GlShaderProgram> shader_program =
-        this->entity->lines_shader_program;
+        depth_peeling_data.transparency_mode == TransparencyMode::a_buffer
+            ? this->entity->lines_a_buffer_shader_program
+            : this->entity->lines_shader_program;
     shader_program->use();
 
     depth_peeling_set_uniforms(shader_program, depth_peeling_data);
@@ -207,9 +251,15 @@ void LinesVisual::Impl::render(
     this->lines->render(false);
 }
 
+bool LinesVisual::Impl::is_opaque() const
+{
+    return this->opaque;
+}
+
 void LinesVisual::Impl::set_lines_data(const std::vector<Vertex> &lines_data)
 {
     this->lines->set_lines_data(lines_data);
+    this->opaque = is_opaque_vertices(lines_data);
 }
 
 LinesVisual::Impl::~Impl(){};
@@ -229,7 +279,11 @@ Expected<std::shared_ptr<LinesVisual>, Error> LinesVisual::create(
 
             std::unique_ptr<LinesVisual::Impl> impl(
                 std::make_unique<LinesVisual::Impl>(
-                    entity, lines.value(), width, cap
+                    entity,
+                    lines.value(),
+                    width,
+                    cap,
+                    is_opaque_vertices(lines_data)
                 )
             );
             return std::shared_ptr<LinesVisual>(new LinesVisual(std::move(impl))
@@ -259,6 +313,11 @@ void LinesVisual::render(
     this->impl->render(scene_size, depth_peeling_data);
 }
 
+bool LinesVisual::is_opaque() const
+{
+    return this->impl->is_opaque();
+}
+
 void LinesVisual::set_model(const glm::mat4 &model)
 {
     this->impl->model = model;
@@ -303,10 +362,13 @@ LinesVisual::LinesVisual(std::unique_ptr<LinesVisual::Impl> impl)
 {}
 
 SurfaceVisual::Impl::Impl(
-    std::shared_ptr<Entity> entity, std::shared_ptr<GlSurface> surface
+    std::shared_ptr<Entity> entity,
+    std::shared_ptr<GlSurface> surface,
+    const bool opaque
 )
     : entity(entity),
       surface(surface),
+      opaque(opaque),
       model(1.0f),
       view(1.0f),
       projection(1.0f),
@@ -323,7 +385,9 @@ void SurfaceVisual::Impl::render(
 ) const
 {
     std::shared_ptr<GlShaderProgram> shader_program =
-        this->entity->surface_shader_program;
+        depth_peeling_data.transparency_mode == TransparencyMode::a_buffer
+            ? this->entity->surface_a_buffer_shader_program
+            : this->entity->surface_shader_program;
     shader_program->use();
 
     depth_peeling_set_uniforms(shader_program, depth_peeling_data);
@@ -360,9 +424,15 @@ void SurfaceVisual::Impl::render(
     this->surface->render(false);
 }
 
+bool SurfaceVisual::Impl::is_opaque() const
+{
+    return this->opaque;
+}
+
 void SurfaceVisual::Impl::set_surface_data(const SurfaceData &surface_data)
 {
     this->surface->set_surface_data(surface_data);
+    this->opaque = surface_data.is_opaque();
 }
 
 SurfaceVisual::Impl::~Impl(){};
@@ -380,7 +450,9 @@ Expected<std::shared_ptr<SurfaceVisual>, Error>
                 return Unexpected<Error>(Error());
 
             std::unique_ptr<SurfaceVisual::Impl> impl(
-                std::make_unique<SurfaceVisual::Impl>(entity, surface.value())
+                std::make_unique<SurfaceVisual::Impl>(
+                    entity, surface.value(), surface_data.is_opaque()
+                )
             );
             return std::shared_ptr<SurfaceVisual>(
                 new SurfaceVisual(std::move(impl))
@@ -413,6 +485,11 @@ void SurfaceVisual::render(
     this->impl->render(scene_size, depth_peeling_data);
 }
 
+bool SurfaceVisual::is_opaque() const
+{
+    return this->impl->is_opaque();
+}
+
 void SurfaceVisual::set_model(const glm::mat4 &model)
 {
     this->impl->model = model;
@@ -487,7 +564,9 @@ void CircleVisual::Impl::render(
 ) const
 {
     std::shared_ptr<GlShaderProgram> shader_program =
-        this->entity->circle_shader_program;
+        depth_peeling_data.transparency_mode == TransparencyMode::a_buffer
+            ? this->entity->circle_a_buffer_shader_program
+            : this->entity->circle_shader_program;
     shader_program->use();
 
     depth_peeling_set_uniforms(shader_program, depth_peeling_data);
@@ -508,6 +587,11 @@ void CircleVisual::Impl::render(
     this->entity->circle->render(false);
 }
 
+bool CircleVisual::Impl::is_opaque() const
+{
+    return is_opaque_color(this->color);
+}
+
 CircleVisual::Impl::~Impl(){};
 
 Expected<std::shared_ptr<CircleVisual>, Error>
@@ -548,6 +632,11 @@ void CircleVisual::render(
     this->impl->render(scene_size, depth_peeling_data);
 }
 
+bool CircleVisual::is_opaque() const
+{
+    return this->impl->is_opaque();
+}
+
 void CircleVisual::set_model(const glm::mat4 &model)
 {
     this->impl->model = model;
@@ -17,12 +17,14 @@ public:
     Impl(
         std::shared_ptr<Entity> entity,
         std::shared_ptr<GlLinesegments> linesegments,
-        const LineCap cap
+        const LineCap cap,
+        const bool opaque
     );
 
     void render(
         const glm::uvec2 &scene_size, const DepthPeelingData &depth_peeling_data
     ) const;
+    bool is_opaque() const;
 
     void set_linesegments_data(const std::vector<Linesegment> &linesegments_data
     );
@@ -38,6 +40,7 @@ private:
 
     std::shared_ptr<Entity> entity;
     std::shared_ptr<GlLinesegments> linesegments;
+    bool opaque;
 
 public:
 
@@ -56,12 +59,14 @@ public:
         std::shared_ptr<Entity> entity,
         std::shared_ptr<GlLines> lines,
         const float width,
-        const LineCap cap
+        const LineCap cap,
+        const bool opaque
     );
 
     void render(
         const glm::uvec2 &scene_size, const DepthPeelingData &depth_peeling_data
     ) const;
+    bool is_opaque() const;
 
     void set_lines_data(const std::vector<Vertex> &lines_data);
 
@@ -76,6 +81,7 @@ private:
 
     std::shared_ptr<Entity> entity;
     std::shared_ptr<GlLines> lines;
+    bool opaque;
 
 public:
 
@@ -91,11 +97,16 @@ class SurfaceVisual::Impl
 {
 public:
 
-    Impl(std::shared_ptr<Entity> entity, std::shared_ptr<GlSurface> surface);
+    Impl(
+        std::shared_ptr<Entity> entity,
+        std::shared_ptr<GlSurface> surface,
+        const bool opaque
+    );
 
     void render(
         const glm::uvec2 &scene_size, const DepthPeelingData &depth_peeling_data
     ) const;
+    bool is_opaque() const;
 
     void set_surface_data(const SurfaceData &surface_data);
 
@@ -110,6 +121,7 @@ private:
 
     std::shared_ptr<Entity> entity;
     std::shared_ptr<GlSurface> surface;
+    bool opaque;
 
 public:
 
@@ -134,6 +146,7 @@ public:
     void render(
         const glm::uvec2 &scene_size, const DepthPeelingData &depth_peeling_data
     ) const;
+    bool is_opaque() const;
 
     Impl(Impl &&other) = delete;
     Impl &operator=(Impl &&other) = delete;
@@ -1,6 +1,6 @@
 #include <gl_shader_program.hpp>
 #include <glad/gl.h>
-#include <glm/gtc/matrix_transform.hpp>
+#include <render_mode.hpp>
 #include <window.hpp>
 
 namespace elementary_visualizer
@@ -42,6 +42,9 @@ void Window::Impl::render(
         const glm::uvec2 scene_size = rendered_scene->get_size();
 
         this->glfw_window->make_current_context();
+        // The scene is rendered in an other context, so our commands have to
+        // wait on the GPU until its rendering has completed.
+        rendered_scene->server_wait_rendered();
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glViewport(0, 0, window_size.x, window_size.y);
 
@@ -52,41 +55,10 @@ void Window::Impl::render(
             this->entity->quad_shader_program;
         shader_program->use(false);
 
-        const float window_width = static_cast<float>(window_size.x);
-        const float window_height = static_cast<float>(window_size.y);
-        const float scene_width = static_cast<float>(scene_size.x);
-        const float scene_height = static_cast<float>(scene_size.y);
-        const float window_aspect = window_width / window_height;
-        const float scene_aspect = scene_width / scene_height;
-
-        glm::vec3 scale = glm::vec3(scene_aspect, 1.0f, 1.0f);
-        glm::mat4 model = glm::scale(glm::mat4(1.0f), scale);
-        glm::mat4 view(1.0f);
-        glm::mat4 projection(1.0f);
-        if ((render_mode == RenderMode::fill && window_aspect > scene_aspect) ||
-            (render_mode == RenderMode::fit && window_aspect <= scene_aspect))
-        {
-            projection = glm::ortho(
-                -scene_aspect,
-                +scene_aspect,
-                -scene_aspect / window_aspect,
-                +scene_aspect / window_aspect
-            );
-        }
-        else if ((render_mode == RenderMode::fill && window_aspect <= scene_aspect) || (render_mode == RenderMode::fit && window_aspect > scene_aspect))
-        {
-            projection =
-                glm::ortho(-window_aspect, +window_aspect, -1.0f, +1.0f);
-        }
-        else if (render_mode == RenderMode::absolute)
-        {
-            projection = glm::ortho(
-                -window_width / scene_height,
-                +window_width / scene_height,
-                -window_height / scene_height,
-                +window_height / scene_height
-            );
-        }
+        const glm::mat4 model = render_mode_model(scene_size);
+        const glm::mat4 view(1.0f);
+        const glm::mat4 projection =
+            render_mode_projection(render_mode, window_size, scene_size);
 
         shader_program->set_uniform("model", model);
         shader_program->set_uniform("view", view);
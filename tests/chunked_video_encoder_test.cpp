@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <elementary_visualizer/elementary_visualizer.hpp>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/mathematics.h>
+#include <libavutil/mem.h>
+}
+
+namespace ev = elementary_visualizer;
+
+struct MemoryReader
+{
+    const std::vector<uint8_t> *memory;
+    size_t position;
+};
+
+static int read_memory(void *opaque, uint8_t *buffer, int buffer_size)
+{
+    MemoryReader *reader = static_cast<MemoryReader *>(opaque);
+    const size_t size = std::min(
+        static_cast<size_t>(buffer_size),
+        reader->memory->size() - reader->position
+    );
+    if (size == 0)
+        return AVERROR_EOF;
+    std::memcpy(buffer, reader->memory->data() + reader->position, size);
+    reader->position += size;
+    return static_cast<int>(size);
+}
+
+bool test_chunk_timestamps(
+    const std::vector<uint8_t> &memory,
+    const unsigned int number_of_frames,
+    const unsigned int frame_rate
+);
+
+// Encodes frames in chunks into memory, and checks that the demuxed
+// packets follow each other across the chunk boundaries.
+int main(int, char **)
+{
+    // The last chunk is shorter than the others.
+    const unsigned int number_of_frames = 18;
+    // Matroska counts in milliseconds, where a frame is exactly 40.
+    const unsigned int frame_rate = 25;
+    const glm::uvec2 scene_size(64, 48);
+
+    auto scene = ev::Scene::create(scene_size, glm::vec4(1.0f), std::nullopt);
+    if (!scene)
+        return EXIT_FAILURE;
+
+    ev::VideoOutput output;
+    output.file_name = "chunks.mkv";
+    output.options.chunk_size = 4;
+    output.options.chunk_thread_count = 3;
+    output.options.output_memory = std::make_shared<std::vector<uint8_t>>();
+
+    {
+        auto video = ev::Video::create({output}, scene_size, frame_rate);
+        if (!video)
+            return EXIT_FAILURE;
+
+        for (unsigned int frame = 0; frame < number_of_frames; ++frame)
+        {
+            scene.value()->set_background_color(
+                glm::vec4(frame / 255.0f, 0.5f, 1.0f, 1.0f)
+            );
+            if (!video.value()->render(scene.value()->render()))
+                return EXIT_FAILURE;
+        }
+        if (!video.value()->finish())
+            return EXIT_FAILURE;
+    }
+
+    if (!test_chunk_timestamps(
+            *output.options.output_memory, number_of_frames, frame_rate
+        ))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+bool test_chunk_timestamps(
+    const std::vector<uint8_t> &memory,
+    const unsigned int number_of_frames,
+    const unsigned int frame_rate
+)
+{
+    MemoryReader reader = {&memory, 0};
+    const int buffer_size = 4096;
+    uint8_t *buffer = static_cast<uint8_t *>(av_malloc(buffer_size));
+    if (!buffer)
+        return false;
+    AVIOContext *io_context = avio_alloc_context(
+        buffer, buffer_size, 0, &reader, read_memory, nullptr, nullptr
+    );
+    if (!io_context)
+    {
+        av_free(buffer);
+        return false;
+    }
+
+    AVFormatContext *format_context = avformat_alloc_context();
+    if (!format_context)
+    {
+        av_freep(&io_context->buffer);
+        avio_context_free(&io_context);
+        return false;
+    }
+    format_context->pb = io_context;
+    // The format context is freed if the opening fails.
+    bool success =
+        avformat_open_input(&format_context, nullptr, nullptr, nullptr) == 0;
+
+    if (success && format_context->nb_streams != 1)
+        success = false;
+
+    unsigned int number_of_packets = 0;
+    AVPacket *packet = av_packet_alloc();
+    if (!packet)
+        success = false;
+    if (success)
+    {
+        const AVRational time_base = format_context->streams[0]->time_base;
+        const int64_t frame_duration =
+            av_rescale_q(1, AVRational{1, int(frame_rate)}, time_base);
+
+        int64_t previous_dts = AV_NOPTS_VALUE;
+        int64_t previous_pts = AV_NOPTS_VALUE;
+        while (success && av_read_frame(format_context, packet) >= 0)
+        {
+            if (packet->dts == AV_NOPTS_VALUE || packet->pts == AV_NOPTS_VALUE)
+                success = false;
+            else if (previous_dts != AV_NOPTS_VALUE &&
+                     packet->dts <= previous_dts)
+                success = false;
+            // There are no B-frames, so the frames are in order,
+            // and a gap would be a frame lost between two chunks.
+            else if (previous_pts != AV_NOPTS_VALUE &&
+                     packet->pts != previous_pts + frame_duration)
+                success = false;
+            previous_dts = packet->dts;
+            previous_pts = packet->pts;
+            ++number_of_packets;
+            av_packet_unref(packet);
+        }
+    }
+    av_packet_free(&packet);
+
+    avformat_close_input(&format_context);
+    av_freep(&io_context->buffer);
+    avio_context_free(&io_context);
+
+    return success && number_of_packets == number_of_frames;
+}
@@ -0,0 +1,262 @@
+#include <av_resources.hpp>
+#include <cstdlib>
+#include <palette_quantizer.hpp>
+#include <vector>
+
+namespace ev = elementary_visualizer;
+
+bool test_rgba8_row_to_15_bit(const size_t width);
+bool test_quantize_frames(
+    const unsigned int width,
+    const unsigned int height,
+    const enum AVPixelFormat pixel_format,
+    const unsigned int thread_count
+);
+bool test_quantize_many_colors(const unsigned int thread_count);
+
+int main(int, char **)
+{
+    // The widths cover the vectorized parts and the remaining pixels.
+    for (size_t width = 1; width <= 37; ++width)
+    {
+        if (!test_rgba8_row_to_15_bit(width))
+            return EXIT_FAILURE;
+    }
+
+    if (!test_quantize_frames(30, 20, AV_PIX_FMT_RGBA, 1))
+        return EXIT_FAILURE;
+    if (!test_quantize_frames(30, 20, AV_PIX_FMT_RGB24, 1))
+        return EXIT_FAILURE;
+    // Large enough to be split between the threads.
+    if (!test_quantize_frames(512, 300, AV_PIX_FMT_RGBA, 4))
+        return EXIT_FAILURE;
+
+    if (!test_quantize_many_colors(1))
+        return EXIT_FAILURE;
+    if (!test_quantize_many_colors(4))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+bool test_rgba8_row_to_15_bit(const size_t width)
+{
+    std::vector<uint8_t> source(4 * width);
+    for (size_t i = 0; i < source.size(); ++i)
+        source[i] = static_cast<uint8_t>(37 * i + i / 3);
+
+    std::vector<uint16_t> destination(width);
+    ev::rgba8_row_to_15_bit(source.data(), width, destination.data());
+
+    for (size_t x = 0; x < width; ++x)
+    {
+        const uint16_t expected = static_cast<uint16_t>(
+            ((source[4 * x + 0] >> 3) << 10) |
+            ((source[4 * x + 1] >> 3) << 5) | (source[4 * x + 2] >> 3)
+        );
+        if (destination[x] != expected)
+            return false;
+    }
+
+    return true;
+}
+
+// Color of a pixel, which is one of 200 colors. Each component
+// is a 5-bit value expanded to 8 bits, so that the palette
+// reproduces the colors exactly.
+static uint32_t pixel_color(const size_t frame, const size_t x, const size_t y)
+{
+    const size_t index = (frame * 7 + x / 3 + 11 * (y / 2)) % 200;
+    const uint32_t r = (index * 13) % 32;
+    const uint32_t g = (index / 7) % 32;
+    const uint32_t b = (index * 5 + index / 32) % 32;
+    return (((r << 3) | (r >> 2)) << 16) | (((g << 3) | (g >> 2)) << 8) |
+           ((b << 3) | (b >> 2));
+}
+
+bool test_quantize_frames(
+    const unsigned int width,
+    const unsigned int height,
+    const enum AVPixelFormat pixel_format,
+    const unsigned int thread_count
+)
+{
+    const size_t frame_count = 3;
+    const size_t channels = pixel_format == AV_PIX_FMT_RGBA ? 4 : 3;
+
+    ev::Expected<std::shared_ptr<ev::PaletteQuantizer>, ev::Error>
+        palette_quantizer =
+            ev::PaletteQuantizer::create(
+                width, height, 0, frame_count, thread_count
+            );
+    if (!palette_quantizer)
+        return false;
+
+    for (size_t frame = 0; frame < frame_count; ++frame)
+    {
+        ev::Expected<std::shared_ptr<ev::WrappedAvFrame>, ev::Error> source =
+            ev::WrappedAvFrame::create(pixel_format, width, height);
+        if (!source)
+            return false;
+        AVFrame *av_source = **source.value();
+        for (size_t y = 0; y < height; ++y)
+        {
+            uint8_t *row = av_source->data[0] + y * av_source->linesize[0];
+            for (size_t x = 0; x < width; ++x)
+            {
+                const uint32_t color = pixel_color(frame, x, y);
+                row[channels * x + 0] = (color >> 16) & 0xff;
+                row[channels * x + 1] = (color >> 8) & 0xff;
+                row[channels * x + 2] = color & 0xff;
+                if (channels == 4)
+                    row[channels * x + 3] = 0xff;
+            }
+        }
+        av_source->pts = 10 * frame;
+
+        if (!palette_quantizer.value()->add_frame(av_source))
+            return false;
+    }
+
+    if (palette_quantizer.value()->get_frame_count() != frame_count)
+        return false;
+    // The palette is generated from all the frames.
+    if (!palette_quantizer.value()->is_sample_complete() ||
+        palette_quantizer.value()->has_palette())
+        return false;
+
+    palette_quantizer.value()->generate_palette();
+    if (palette_quantizer.value()->is_sample_complete() ||
+        !palette_quantizer.value()->has_palette())
+        return false;
+
+    ev::Expected<std::shared_ptr<ev::WrappedAvFrame>, ev::Error> destination =
+        ev::WrappedAvFrame::create(AV_PIX_FMT_PAL8, width, height);
+    if (!destination)
+        return false;
+    AVFrame *av_destination = **destination.value();
+
+    for (size_t frame = 0; frame < frame_count; ++frame)
+    {
+        if (palette_quantizer.value()->get_frame_timestamp(frame) !=
+            static_cast<int64_t>(10 * frame))
+            return false;
+
+        palette_quantizer.value()->quantize_frame(frame, av_destination);
+
+        const uint32_t *palette =
+            reinterpret_cast<const uint32_t *>(av_destination->data[1]);
+        for (size_t y = 0; y < height; ++y)
+        {
+            const uint8_t *row =
+                av_destination->data[0] + y * av_destination->linesize[0];
+            for (size_t x = 0; x < width; ++x)
+            {
+                if (palette[row[x]] != (0xff000000 | pixel_color(frame, x, y)))
+                    return false;
+            }
+        }
+    }
+
+    palette_quantizer.value()->clear();
+    if (palette_quantizer.value()->get_frame_count() != 0)
+        return false;
+
+    return true;
+}
+
+bool test_quantize_many_colors(const unsigned int thread_count)
+{
+    const unsigned int width = 64;
+    const unsigned int height = 64;
+    const size_t frame_count = 6;
+    // The palettes are generated from the first 2 frames
+    // of the segments of 4 frames. Every frame has the same
+    // 4096 colors, and only the later frames of a segment
+    // are quantized without being counted.
+    const unsigned int segment_size = 4;
+    const unsigned int sample_size = 2;
+
+    ev::Expected<std::shared_ptr<ev::PaletteQuantizer>, ev::Error>
+        palette_quantizer = ev::PaletteQuantizer::create(
+            width, height, segment_size, sample_size, thread_count
+        );
+    if (!palette_quantizer)
+        return false;
+
+    ev::Expected<std::shared_ptr<ev::WrappedAvFrame>, ev::Error> destination =
+        ev::WrappedAvFrame::create(AV_PIX_FMT_PAL8, width, height);
+    if (!destination)
+        return false;
+    AVFrame *av_destination = **destination.value();
+
+    size_t quantized_frame_count = 0;
+    for (size_t frame = 0; frame < frame_count; ++frame)
+    {
+        ev::Expected<std::shared_ptr<ev::WrappedAvFrame>, ev::Error> source =
+            ev::WrappedAvFrame::create(AV_PIX_FMT_RGBA, width, height);
+        if (!source)
+            return false;
+        AVFrame *av_source = **source.value();
+        for (size_t y = 0; y < height; ++y)
+        {
+            uint8_t *row = av_source->data[0] + y * av_source->linesize[0];
+            for (size_t x = 0; x < width; ++x)
+            {
+                row[4 * x + 0] = static_cast<uint8_t>(4 * x);
+                row[4 * x + 1] = static_cast<uint8_t>(4 * y);
+                row[4 * x + 2] = static_cast<uint8_t>(2 * (x + y));
+                row[4 * x + 3] = 0xff;
+            }
+        }
+        av_source->pts = frame;
+
+        if (!palette_quantizer.value()->add_frame(av_source))
+            return false;
+        if (!palette_quantizer.value()->has_palette() &&
+            !palette_quantizer.value()->is_sample_complete())
+            continue;
+        if (!palette_quantizer.value()->has_palette())
+            palette_quantizer.value()->generate_palette();
+
+        for (size_t i = 0; i < palette_quantizer.value()->get_frame_count();
+             ++i)
+        {
+            const size_t quantized_frame = static_cast<size_t>(
+                palette_quantizer.value()->get_frame_timestamp(i)
+            );
+            if (quantized_frame != quantized_frame_count)
+                return false;
+            ++quantized_frame_count;
+
+            palette_quantizer.value()->quantize_frame(i, av_destination);
+
+            // Each color is replaced by a near one.
+            const uint32_t *palette =
+                reinterpret_cast<const uint32_t *>(av_destination->data[1]);
+            for (size_t y = 0; y < height; ++y)
+            {
+                const uint8_t *row =
+                    av_destination->data[0] + y * av_destination->linesize[0];
+                for (size_t x = 0; x < width; ++x)
+                {
+                    const uint32_t color = palette[row[x]];
+                    const int errors[] = {
+                        static_cast<int>((color >> 16) & 0xff) -
+                            static_cast<int>(4 * x),
+                        static_cast<int>((color >> 8) & 0xff) -
+                            static_cast<int>(4 * y),
+                        static_cast<int>(color & 0xff) -
+                            static_cast<int>(2 * (x + y))
+                    };
+                    for (const int error : errors)
+                        if (std::abs(error) > 16)
+                            return false;
+                }
+            }
+        }
+        palette_quantizer.value()->clear();
+    }
+
+    return quantized_frame_count == frame_count;
+}
@@ -0,0 +1,151 @@
+#include <cstdlib>
+#include <pixel_packing.hpp>
+#include <vector>
+
+namespace ev = elementary_visualizer;
+
+bool test_pack_rgba_float_image(
+    const glm::uvec2 &size,
+    const ev::PackedPixelFormat format,
+    const bool flip_vertically
+);
+bool test_pack_rgba_float_row(
+    const size_t width,
+    const ev::PackedPixelFormat format,
+    const ev::PixelPackingKernel kernel
+);
+std::vector<float> make_source(const size_t pixels);
+
+int main(int, char **)
+{
+    // The widths cover the vectorized parts and the remaining pixels.
+    for (unsigned int width = 1; width <= 37; ++width)
+    {
+        for (const auto format :
+             {ev::PackedPixelFormat::rgb24, ev::PackedPixelFormat::rgba8})
+        {
+            if (!test_pack_rgba_float_image(glm::uvec2(width, 3), format, true))
+                return EXIT_FAILURE;
+            if (!test_pack_rgba_float_image(
+                    glm::uvec2(width, 3), format, false
+                ))
+                return EXIT_FAILURE;
+
+            // Every kernel is checked, not only the one picked at runtime.
+            // The ones this processor cannot run are skipped.
+            for (const auto kernel :
+                 {ev::PixelPackingKernel::scalar,
+                  ev::PixelPackingKernel::ssse3,
+                  ev::PixelPackingKernel::avx2})
+            {
+                if (!ev::is_pixel_packing_kernel_supported(kernel))
+                    continue;
+                if (!test_pack_rgba_float_row(width, format, kernel))
+                    return EXIT_FAILURE;
+            }
+        }
+    }
+
+    if (!ev::is_pixel_packing_kernel_supported(ev::PixelPackingKernel::scalar))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+bool test_pack_rgba_float_image(
+    const glm::uvec2 &size,
+    const ev::PackedPixelFormat format,
+    const bool flip_vertically
+)
+{
+    const std::vector<float> source = make_source(size.x * size.y);
+
+    const size_t channels = format == ev::PackedPixelFormat::rgba8 ? 4 : 3;
+    // Padding at the end of the rows, which must not be written.
+    const size_t linesize = channels * size.x + 5;
+    const uint8_t padding = 123;
+    std::vector<uint8_t> destination(linesize * size.y, padding);
+
+    ev::pack_rgba_float_image(
+        source.data(),
+        size,
+        format,
+        destination.data(),
+        linesize,
+        flip_vertically
+    );
+
+    for (unsigned int y = 0; y < size.y; ++y)
+    {
+        const unsigned int destination_y =
+            flip_vertically ? (size.y - 1) - y : y;
+        const uint8_t *row = destination.data() + linesize * destination_y;
+        for (unsigned int x = 0; x < size.x; ++x)
+        {
+            for (size_t channel = 0; channel < channels; ++channel)
+            {
+                const uint8_t expected =
+                    ev::to_8_bit(source[4 * (size.x * y + x) + channel]);
+                if (row[channels * x + channel] != expected)
+                    return false;
+            }
+        }
+        for (size_t i = channels * size.x; i < linesize; ++i)
+        {
+            if (row[i] != padding)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool test_pack_rgba_float_row(
+    const size_t width,
+    const ev::PackedPixelFormat format,
+    const ev::PixelPackingKernel kernel
+)
+{
+    const std::vector<float> source = make_source(width);
+
+    const size_t channels = format == ev::PackedPixelFormat::rgba8 ? 4 : 3;
+    // Padding after the row, which must not be written.
+    const uint8_t padding = 123;
+    std::vector<uint8_t> destination(channels * width + 5, padding);
+
+    ev::pack_rgba_float_row(
+        source.data(), width, format, destination.data(), kernel
+    );
+
+    for (size_t x = 0; x < width; ++x)
+    {
+        for (size_t channel = 0; channel < channels; ++channel)
+        {
+            const uint8_t expected =
+                ev::to_8_bit(source[4 * x + channel]);
+            if (destination[channels * x + channel] != expected)
+                return false;
+        }
+    }
+    for (size_t i = channels * width; i < destination.size(); ++i)
+    {
+        if (destination[i] != padding)
+            return false;
+    }
+
+    return true;
+}
+
+std::vector<float> make_source(const size_t pixels)
+{
+    // Includes values out of range, and values right at the rounding.
+    const std::vector<float> values = {
+        -1.0f, -0.001f, 0.0f, 0.5f / 255.0f, 1.0f / 255.0f, 0.25f, 0.5f,
+        0.999f, 254.999f / 255.0f, 1.0f, 1.001f, 2.0f, 1000.0f
+    };
+
+    std::vector<float> source(4 * pixels);
+    for (size_t i = 0; i < source.size(); ++i)
+        source[i] = values[(7 * i + i / 5) % values.size()];
+    return source;
+}
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <elementary_visualizer/shared_frame_ring.hpp>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace ev = elementary_visualizer;
+
+// Consumer process of shared_frame_ring_test. It reads the frames
+// from the shared memory, and checks that each frame has the color
+// which belongs to its sequence number.
+// Usage: shared_frame_ring_consumer name number_of_frames
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+        return EXIT_FAILURE;
+    const std::string name = argv[1];
+    const uint64_t number_of_frames = std::stoull(argv[2]);
+
+    // The producer might not have created the shared memory yet.
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    const off_t header_size =
+        static_cast<off_t>(sizeof(ev::SharedFrameRingHeader));
+    int file_descriptor = -1;
+    struct stat status = {};
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if (file_descriptor < 0)
+            file_descriptor = shm_open(name.c_str(), O_RDWR, 0);
+        if (file_descriptor >= 0 && fstat(file_descriptor, &status) == 0 &&
+            status.st_size >= header_size)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (file_descriptor < 0 || status.st_size < header_size)
+        return EXIT_FAILURE;
+
+    const size_t memory_size = static_cast<size_t>(status.st_size);
+    void *memory = mmap(
+        nullptr,
+        memory_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        file_descriptor,
+        0
+    );
+    close(file_descriptor);
+    if (memory == MAP_FAILED)
+        return EXIT_FAILURE;
+
+    ev::SharedFrameRingHeader *header =
+        static_cast<ev::SharedFrameRingHeader *>(memory);
+    // The rest of the header is set before the magic.
+    while (header->magic.load(std::memory_order_acquire) !=
+           ev::shared_frame_ring_magic)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return EXIT_FAILURE;
+        std::this_thread::yield();
+    }
+
+    if (header->version != ev::shared_frame_ring_version ||
+        header->format != ev::SharedFrameFormat::rgba8)
+        return EXIT_FAILURE;
+
+    // The blocked producer gives up once this process is gone.
+    header->consumer_pid.store(getpid(), std::memory_order_relaxed);
+
+    uint8_t *slots = static_cast<uint8_t *>(memory) + header->slots_offset;
+
+    uint64_t read_index = 0;
+    while (read_index < number_of_frames)
+    {
+        if (header->write_index.load(std::memory_order_acquire) ==
+            read_index)
+        {
+            if (header->closed.load(std::memory_order_acquire))
+                return EXIT_FAILURE;
+            std::this_thread::yield();
+            continue;
+        }
+
+        const uint8_t *slot =
+            slots + (read_index % header->slot_count) * header->slot_size;
+        const uint64_t sequence =
+            reinterpret_cast<const ev::SharedFrameSlotHeader *>(slot)
+                ->sequence;
+        // The producer blocks, so no frame is dropped.
+        if (sequence != read_index)
+            return EXIT_FAILURE;
+
+        // The red component is the sequence number,
+        // the others are constant.
+        const uint8_t *frame = slot + header->frame_offset;
+        for (uint64_t i = 0; i < header->frame_size; i += 4)
+        {
+            if (frame[i + 0] != sequence || frame[i + 1] != 128 ||
+                frame[i + 2] != 255 || frame[i + 3] != 255)
+                return EXIT_FAILURE;
+        }
+
+        ++read_index;
+        header->read_index.store(read_index, std::memory_order_release);
+    }
+
+    munmap(memory, memory_size);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+#include <cstdlib>
+#include <elementary_visualizer/elementary_visualizer.hpp>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ev = elementary_visualizer;
+
+// Publishes frames into shared memory, which are checked by
+// a consumer process.
+int main(int, char **)
+{
+    const std::string name =
+        "/elementary_visualizer_test_" + std::to_string(getpid());
+    const unsigned int number_of_frames = 32;
+    const glm::uvec2 scene_size(64, 48);
+
+    auto scene = ev::Scene::create(scene_size, glm::vec4(1.0f), std::nullopt);
+    if (!scene)
+        return EXIT_FAILURE;
+
+    pid_t consumer;
+    {
+        // The shared memory is created here, and it is unlinked
+        // when the video is destroyed.
+        auto video = ev::Video::create(
+            {ev::VideoOutput::shared_memory(
+                name, 4, ev::EncodingQueuePolicy::block
+            )},
+            scene_size
+        );
+        if (!video)
+            return EXIT_FAILURE;
+
+        const std::string number_of_frames_string =
+            std::to_string(number_of_frames);
+        char *const arguments[] = {
+            const_cast<char *>(SHARED_FRAME_RING_CONSUMER),
+            const_cast<char *>(name.c_str()),
+            const_cast<char *>(number_of_frames_string.c_str()),
+            nullptr
+        };
+        if (posix_spawn(
+                &consumer,
+                SHARED_FRAME_RING_CONSUMER,
+                nullptr,
+                nullptr,
+                arguments,
+                environ
+            ) != 0)
+            return EXIT_FAILURE;
+
+        // The red component is the frame number, which survives
+        // the conversion into 8 bits exactly.
+        for (unsigned int frame = 0; frame < number_of_frames; ++frame)
+        {
+            scene.value()->set_background_color(
+                glm::vec4(frame / 255.0f, 128.0f / 255.0f, 1.0f, 1.0f)
+            );
+            video.value()->render(scene.value()->render());
+        }
+    }
+
+    int status;
+    if (waitpid(consumer, &status, 0) != consumer)
+        return EXIT_FAILURE;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    // Without a consumer, the blocked frames time out
+    // instead of hanging the rendering.
+    {
+        ev::VideoOutput output = ev::VideoOutput::shared_memory(
+            name, 2, ev::EncodingQueuePolicy::block
+        );
+        output.shared_memory_timeout = 100;
+        auto video = ev::Video::create({output}, scene_size);
+        if (!video)
+            return EXIT_FAILURE;
+
+        for (unsigned int frame = 0; frame < 4; ++frame)
+            video.value()->render(scene.value()->render());
+        if (video.value()->finish())
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -10,6 +10,8 @@ std::size_t rendered_scene_hash(
 )
 {
     std::vector<float> rendered_scene_data(4 * size.x * size.y);
+    if (!rendered_scene->client_wait_rendered())
+        return 0;
     rendered_scene->bind();
     glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, &rendered_scene_data[0]);
 
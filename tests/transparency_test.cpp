@@ -0,0 +1,305 @@
+#include <cmath>
+#include <cstdlib>
+#include <elementary_visualizer/elementary_visualizer.hpp>
+#include <gl_resources.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace ev = elementary_visualizer;
+
+bool test_transparency_mode(
+    const ev::SceneOptions &options,
+    const std::optional<int> samples,
+    const int render_count = 1
+);
+bool test_layers(
+    const ev::SceneOptions &options,
+    const std::optional<int> samples,
+    const std::vector<glm::vec4> &layer_colors,
+    const glm::vec3 &expected_color,
+    const std::optional<int> depth_peeling_passes = std::nullopt,
+    const std::optional<float> opaque_z = std::nullopt,
+    const int render_count = 1
+);
+
+// Translucent red layers, all of the same color.
+static std::vector<glm::vec4> red_layers(const int layer_count)
+{
+    return std::vector<glm::vec4>(
+        layer_count, glm::vec4(1.0f, 0.0f, 0.0f, 0.5f)
+    );
+}
+
+// Translucent layers of different colors and alphas, from front
+// to back, so that their order matters.
+static std::vector<glm::vec4> colored_layers(const int layer_count)
+{
+    const glm::vec4 colors[4] = {
+        glm::vec4(1.0f, 0.0f, 0.0f, 0.5f),
+        glm::vec4(0.0f, 1.0f, 0.0f, 0.25f),
+        glm::vec4(0.0f, 0.0f, 1.0f, 0.5f),
+        glm::vec4(1.0f, 1.0f, 0.0f, 0.75f)
+    };
+    return std::vector<glm::vec4>(colors, colors + layer_count);
+}
+
+// The color which the transparency mode gives for the layers
+// over the white background.
+static glm::vec3 expected_layers_color(
+    const ev::SceneOptions &options, const std::vector<glm::vec4> &layer_colors
+)
+{
+    const glm::vec3 background(1.0f);
+
+    // The alphas are large enough, and the layers near enough,
+    // that every weight is clamped to the same maximum. So the colors
+    // are averaged by their alpha, and cover the background
+    // by the product of the alphas.
+    if (options.transparency_mode == ev::TransparencyMode::weighted_blended)
+    {
+        glm::vec3 color_sum(0.0f);
+        float alpha_sum = 0.0f;
+        float revealage = 1.0f;
+        for (const glm::vec4 &layer_color : layer_colors)
+        {
+            color_sum += glm::vec3(layer_color) * layer_color.a;
+            alpha_sum += layer_color.a;
+            revealage *= 1.0f - layer_color.a;
+        }
+        return color_sum / alpha_sum * (1.0f - revealage) +
+               background * revealage;
+    }
+
+    // The other modes blend the layers exactly, back to front.
+    glm::vec3 color = background;
+    for (auto it = layer_colors.rbegin(); it != layer_colors.rend(); ++it)
+        color = glm::vec3(*it) * it->a + color * (1.0f - it->a);
+    return color;
+}
+
+int main(int, char **)
+{
+    for (const auto transparency_mode :
+         {ev::TransparencyMode::depth_peeling,
+          ev::TransparencyMode::weighted_blended,
+          ev::TransparencyMode::a_buffer,
+          ev::TransparencyMode::dual_depth_peeling})
+    {
+        ev::SceneOptions options;
+        options.transparency_mode = transparency_mode;
+        if (!test_transparency_mode(options, std::nullopt))
+            return EXIT_FAILURE;
+        if (!test_transparency_mode(options, 2))
+            return EXIT_FAILURE;
+    }
+
+    // The depth peeling layers are blended front to back right away.
+    ev::SceneOptions incremental_options;
+    incremental_options.incremental_depth_peeling = true;
+    if (!test_transparency_mode(incremental_options, std::nullopt))
+        return EXIT_FAILURE;
+    if (!test_transparency_mode(incremental_options, 2))
+        return EXIT_FAILURE;
+
+    // The lower precisions give the same result up to their rounding.
+    for (const auto precision :
+         {ev::RenderTargetPrecision::rgba8, ev::RenderTargetPrecision::rgba16f})
+    {
+        ev::SceneOptions options;
+        options.precision = precision;
+        if (!test_transparency_mode(options, std::nullopt))
+            return EXIT_FAILURE;
+        if (!test_transparency_mode(options, 2))
+            return EXIT_FAILURE;
+    }
+
+    // Only the layers which are there are peeled and blended.
+    if (!test_layers(
+            ev::SceneOptions(),
+            2,
+            red_layers(2),
+            glm::vec3(1.0f, 0.25f, 0.25f),
+            8
+        ))
+        return EXIT_FAILURE;
+
+    // A single pass is enough for a translucent layer in front of
+    // an opaque one, and nothing is peeled behind the opaque one.
+    // The dual depth peeling peels only the layer in front of it too,
+    // and the weighted blended transparency leaves out the fragments
+    // behind the opaque one the same way, instead of weighting
+    // them in.
+    for (const auto transparency_mode :
+         {ev::TransparencyMode::depth_peeling,
+          ev::TransparencyMode::weighted_blended,
+          ev::TransparencyMode::dual_depth_peeling})
+    {
+        ev::SceneOptions options;
+        options.transparency_mode = transparency_mode;
+        for (const auto samples :
+             {std::optional<int>(), std::optional<int>(2)})
+        {
+            if (!test_layers(
+                    options,
+                    samples,
+                    red_layers(1),
+                    glm::vec3(0.5f, 0.0f, 0.5f),
+                    1,
+                    0.05f
+                ))
+                return EXIT_FAILURE;
+            if (!test_layers(
+                    options,
+                    samples,
+                    red_layers(2),
+                    glm::vec3(0.5f, 0.0f, 0.5f),
+                    1,
+                    0.05f
+                ))
+                return EXIT_FAILURE;
+            if (!test_layers(
+                    options,
+                    samples,
+                    red_layers(2),
+                    glm::vec3(0.0f, 0.0f, 1.0f),
+                    1,
+                    -0.05f
+                ))
+                return EXIT_FAILURE;
+        }
+    }
+
+    // The A-buffer is too small for the fragments, so it has to grow.
+    // The first frame loses fragments, and the next one fits them.
+    ev::SceneOptions options;
+    options.transparency_mode = ev::TransparencyMode::a_buffer;
+    options.a_buffer_fragments_per_pixel = 0.01f;
+    if (!test_transparency_mode(options, std::nullopt, 2))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+bool test_transparency_mode(
+    const ev::SceneOptions &options,
+    const std::optional<int> samples,
+    const int render_count
+)
+{
+    // Layers of the same color give the same color in any order,
+    // so every mode has to give the exact result for them.
+    const glm::vec3 expected_colors[3] = {
+        glm::vec3(1.0f, 0.5f, 0.5f),
+        glm::vec3(1.0f, 0.25f, 0.25f),
+        glm::vec3(1.0f, 0.125f, 0.125f)
+    };
+    for (int layer_count = 1; layer_count <= 3; ++layer_count)
+    {
+        if (!test_layers(
+                options,
+                samples,
+                red_layers(layer_count),
+                expected_colors[layer_count - 1],
+                std::nullopt,
+                std::nullopt,
+                render_count
+            ))
+            return false;
+    }
+
+    // Layers of different colors, with even and odd layer counts,
+    // which the dual depth peeling splits differently between
+    // its front and back layers.
+    for (int layer_count = 1; layer_count <= 4; ++layer_count)
+    {
+        const std::vector<glm::vec4> layer_colors =
+            colored_layers(layer_count);
+        if (!test_layers(
+                options,
+                samples,
+                layer_colors,
+                expected_layers_color(options, layer_colors),
+                std::nullopt,
+                std::nullopt,
+                render_count
+            ))
+            return false;
+    }
+
+    return true;
+}
+
+bool test_layers(
+    const ev::SceneOptions &options,
+    const std::optional<int> samples,
+    const std::vector<glm::vec4> &layer_colors,
+    const glm::vec3 &expected_color,
+    const std::optional<int> depth_peeling_passes,
+    const std::optional<float> opaque_z,
+    const int render_count
+)
+{
+    const glm::uvec2 scene_size(100, 100);
+    auto scene = ev::Scene::create(
+        scene_size,
+        glm::vec4(1.0f),
+        samples,
+        depth_peeling_passes.value_or(static_cast<int>(layer_colors.size())),
+        options
+    );
+    if (!scene)
+        return false;
+
+    // Translucent circles behind each other, from front to back,
+    // which cover the center of the scene.
+    for (size_t i = 0; i < layer_colors.size(); ++i)
+    {
+        auto circle = ev::CircleVisual::create(layer_colors[i]);
+        if (!circle)
+            return false;
+        circle.value()->set_model(
+            glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.1f * i))
+        );
+        scene.value()->add_visual(circle.value());
+    }
+
+    // An opaque blue circle among them.
+    if (opaque_z)
+    {
+        auto circle =
+            ev::CircleVisual::create(glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+        if (!circle)
+            return false;
+        circle.value()->set_model(glm::translate(
+            glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, opaque_z.value())
+        ));
+        scene.value()->add_visual(circle.value());
+    }
+
+    // Only the last frame is checked.
+    std::shared_ptr<const ev::GlTexture> rendered_scene;
+    for (int i = 0; i < render_count; ++i)
+    {
+        rendered_scene = scene.value()->render();
+        if (!rendered_scene->client_wait_rendered())
+            return false;
+    }
+
+    std::vector<float> rendered_scene_data(4 * scene_size.x * scene_size.y);
+    rendered_scene->bind();
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, &rendered_scene_data[0]);
+
+    const size_t center =
+        4 * (scene_size.x * (scene_size.y / 2) + scene_size.x / 2);
+    const float tolerance =
+        options.precision == ev::RenderTargetPrecision::rgba8 ? 2.0f / 255.0f
+                                                              : 1e-3f;
+    for (int channel = 0; channel < 3; ++channel)
+    {
+        if (std::abs(
+                rendered_scene_data[center + channel] - expected_color[channel]
+            ) > tolerance)
+            return false;
+    }
+
+    return true;
+}